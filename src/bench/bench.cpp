@@ -0,0 +1,314 @@
+#include "executor.h"
+#include "metadata.h"
+#include "storage.h"
+#include "trx.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+using namespace bydb;
+using namespace hsql;
+
+/* Rows are taken round robin from this many distinct generated rows. */
+#define BENCH_DISTINCT_ROWS 1024
+#define BENCH_CHAR_LEN 16
+
+/* Swallows what PrintTuples writes, only the formatting is measured. */
+class NullBuffer : public std::streambuf {
+ protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    return n;
+  }
+};
+
+struct BenchCase {
+  size_t columns;
+  size_t rows;
+};
+
+/* Columns cycle through INT, LONG and CHAR, the values only depend on the row
+and column number so every run loads the same data. */
+class BenchTable {
+ public:
+  BenchTable(size_t columns) {
+    std::vector<ColumnDefinition*> col_defs;
+    for (size_t i = 0; i < columns; i++) {
+      std::string name = "c" + std::to_string(i);
+      ColumnType type(DataType::INT);
+      if (i % 3 == 1) {
+        type = ColumnType(DataType::LONG);
+      } else if (i % 3 == 2) {
+        type = ColumnType(DataType::CHAR, BENCH_CHAR_LEN);
+      }
+      ColumnDefinition* col = new ColumnDefinition(
+          strdup(name.c_str()), type, new std::vector<ConstraintType>());
+      col->nullable = false;
+      col_defs.push_back(col);
+    }
+
+    char schema[] = "bench";
+    char name[] = "t";
+    table_ = new Table(schema, name, &col_defs);
+    for (auto col : col_defs) {
+      delete col;
+    }
+
+    for (size_t r = 0; r < BENCH_DISTINCT_ROWS; r++) {
+      std::vector<Expr*> row;
+      for (size_t i = 0; i < columns; i++) {
+        Expr* expr = nullptr;
+        if (i % 3 == 2) {
+          expr = arena_.alloc<Expr>(kExprLiteralString);
+          std::string str = "s" + std::to_string(r * 31 + i);
+          expr->name = arena_.strdup(str.c_str(), str.length());
+        } else {
+          expr = arena_.alloc<Expr>(kExprLiteralInt);
+          expr->ival = r * 7 + i;
+        }
+        row.push_back(expr);
+      }
+      rows_.push_back(row);
+    }
+  }
+
+  ~BenchTable() { delete table_; }
+
+  Table* table() { return table_; }
+  TableStore* store() {
+    return (*table_->partitions())[0]->getTableStore();
+  }
+  std::vector<Expr*>* row(size_t i) { return &rows_[i % rows_.size()]; }
+
+  void load(size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+      store()->insertTuple(row(i));
+    }
+  }
+
+ private:
+  Arena arena_;
+  Table* table_;
+  std::vector<std::vector<Expr*>> rows_;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t ElapsedNanos(Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                              start)
+      .count();
+}
+
+/* Each run sets up a fresh table, only the operation under test is timed. */
+typedef std::function<uint64_t(const BenchCase&)> BenchFunc;
+
+static uint64_t BenchInsert(const BenchCase& bc) {
+  BenchTable table(bc.columns);
+  Clock::time_point start = Clock::now();
+  table.load(bc.rows);
+  return ElapsedNanos(start);
+}
+
+static uint64_t BenchScanParse(const BenchCase& bc) {
+  BenchTable table(bc.columns);
+  table.load(bc.rows);
+
+  Arena arena;
+  TableStore* store = table.store();
+  size_t cnt = 0;
+  Clock::time_point start = Clock::now();
+  for (Tuple* tup = store->seqScan(nullptr); tup != nullptr;
+       tup = store->seqScan(tup)) {
+    ExprList values(&arena);
+    store->parseTuple(tup, values, &arena);
+    cnt += values.size();
+  }
+  uint64_t nanos = ElapsedNanos(start);
+
+  if (cnt != bc.rows * bc.columns) {
+    std::cerr << "scan_parse: got " << cnt << " values" << std::endl;
+  }
+  return nanos;
+}
+
+static uint64_t BenchFilter(const BenchCase& bc) {
+  BenchTable table(bc.columns);
+  table.load(bc.rows);
+
+  Arena arena;
+  ExecContext ctx(&arena, nullptr);
+  ScanPlan* scan_plan = arena.create<ScanPlan>();
+  scan_plan->type = kSeqScan;
+  scan_plan->table = table.table();
+  FilterPlan* filter_plan = arena.create<FilterPlan>();
+  filter_plan->table = table.table();
+  filter_plan->idx = 0;
+  filter_plan->val = (*table.row(0))[0];
+  filter_plan->next = scan_plan;
+
+  SeqScanOperator* scan = arena.create<SeqScanOperator>(scan_plan, nullptr,
+                                                        &ctx);
+  FilterOperator filter(filter_plan, scan, &ctx);
+  Clock::time_point start = Clock::now();
+  while (true) {
+    TupleIter* iter = nullptr;
+    filter.exec(&iter);
+    if (iter == nullptr) {
+      break;
+    }
+  }
+  return ElapsedNanos(start);
+}
+
+static uint64_t UpdateAll(BenchTable& table) {
+  std::vector<size_t> idxs = {0};
+  std::vector<Expr*> values = {(*table.row(1))[0]};
+  TableStore* store = table.store();
+  Clock::time_point start = Clock::now();
+  for (Tuple* tup = store->seqScan(nullptr); tup != nullptr;
+       tup = store->seqScan(tup)) {
+    store->updateTuple(tup, idxs, values);
+  }
+  return ElapsedNanos(start);
+}
+
+static uint64_t BenchUpdate(const BenchCase& bc) {
+  BenchTable table(bc.columns);
+  table.load(bc.rows);
+  return UpdateAll(table);
+}
+
+static uint64_t BenchUpdateTrx(const BenchCase& bc) {
+  BenchTable table(bc.columns);
+  table.load(bc.rows);
+  g_transaction.begin();
+  uint64_t nanos = UpdateAll(table);
+  g_transaction.commit();
+  return nanos;
+}
+
+static uint64_t BenchRollback(const BenchCase& bc) {
+  BenchTable table(bc.columns);
+  table.load(bc.rows);
+  g_transaction.begin();
+  UpdateAll(table);
+  Clock::time_point start = Clock::now();
+  g_transaction.rollback();
+  return ElapsedNanos(start);
+}
+
+static uint64_t BenchPrint(const BenchCase& bc) {
+  BenchTable table(bc.columns);
+  table.load(bc.rows);
+
+  Arena arena;
+  TableStore* store = table.store();
+  TupleIterList tuples(&arena);
+  for (Tuple* tup = store->seqScan(nullptr); tup != nullptr;
+       tup = store->seqScan(tup)) {
+    TupleIter* iter = arena.alloc<TupleIter>(tup, store, &arena);
+    store->parseTuple(tup, iter->values, &arena);
+    tuples.push_back(iter);
+  }
+
+  std::vector<ColumnDefinition*> columns = *table.table()->columns();
+  std::vector<size_t> col_ids;
+  for (size_t i = 0; i < columns.size(); i++) {
+    col_ids.push_back(i);
+  }
+
+  NullBuffer null_buf;
+  std::streambuf* old_buf = std::cout.rdbuf(&null_buf);
+  Clock::time_point start = Clock::now();
+  PrintTuples(columns, col_ids, tuples);
+  uint64_t nanos = ElapsedNanos(start);
+  std::cout.rdbuf(old_buf);
+  return nanos;
+}
+
+static std::vector<size_t> ParseList(const char* arg) {
+  std::vector<size_t> list;
+  std::string str = arg;
+  size_t pos = 0;
+  while (pos < str.length()) {
+    size_t end = str.find(',', pos);
+    end = (end == std::string::npos) ? str.length() : end;
+    list.push_back(strtoul(str.substr(pos, end - pos).c_str(), nullptr, 10));
+    pos = end + 1;
+  }
+  return list;
+}
+
+/* One JSON object per line, one line per benchmark, width and row count. */
+static void Report(const char* name, const BenchCase& bc,
+                   std::vector<uint64_t>& nanos) {
+  std::sort(nanos.begin(), nanos.end());
+  uint64_t median = nanos[nanos.size() / 2];
+  double ns_per_row = bc.rows == 0 ? 0 : static_cast<double>(median) / bc.rows;
+  printf(
+      "{\"benchmark\": \"%s\", \"columns\": %zu, \"rows\": %zu, "
+      "\"runs\": %zu, \"min_ns\": %lu, \"median_ns\": %lu, "
+      "\"max_ns\": %lu, \"ns_per_row\": %.2f}\n",
+      name, bc.columns, bc.rows, nanos.size(), (unsigned long)nanos.front(),
+      (unsigned long)median, (unsigned long)nanos.back(), ns_per_row);
+  fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<size_t> widths = {2, 8, 32};
+  std::vector<size_t> row_counts = {1000, 10000, 100000};
+  size_t runs = 5;
+  std::string only;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--columns" && i + 1 < argc) {
+      widths = ParseList(argv[++i]);
+    } else if (arg == "--rows" && i + 1 < argc) {
+      row_counts = ParseList(argv[++i]);
+    } else if (arg == "--runs" && i + 1 < argc) {
+      runs = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--filter" && i + 1 < argc) {
+      only = argv[++i];
+    } else {
+      std::cout << "Usage: " << argv[0]
+                << " [--columns <n,...>] [--rows <n,...>] [--runs <num>]"
+                   " [--filter <benchmark>]"
+                << std::endl;
+      return 1;
+    }
+  }
+  runs = std::max<size_t>(runs, 1);
+
+  std::vector<std::pair<const char*, BenchFunc>> benches = {
+      {"insert", BenchInsert},         {"scan_parse", BenchScanParse},
+      {"filter", BenchFilter},         {"update", BenchUpdate},
+      {"update_trx", BenchUpdateTrx},  {"rollback", BenchRollback},
+      {"print", BenchPrint}};
+
+  for (auto& bench : benches) {
+    if (!only.empty() && only != bench.first) {
+      continue;
+    }
+    for (auto columns : widths) {
+      for (auto rows : row_counts) {
+        BenchCase bc = {std::max<size_t>(columns, 1), rows};
+        std::vector<uint64_t> nanos;
+        for (size_t i = 0; i < runs; i++) {
+          nanos.push_back(bench.second(bc));
+        }
+        Report(bench.first, bc, nanos);
+      }
+    }
+  }
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,410 @@
+#include "engine.h"
+#include "scheduler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+using namespace bydb;
+
+#define YCSB_TABLE "ycsb.usertable"
+#define TPCH_TABLE "tpch.lineitem"
+#define ZIPFIAN_THETA 0.99
+
+/* The engine reports every statement on std::cout, which would be measured
+along with it. */
+class NullBuffer : public std::streambuf {
+ protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    return n;
+  }
+};
+
+/* Operation mix of a YCSB core workload. Range scans are not supported by
+the engine, so 'scan' is a full scan filtered on a non-key field. */
+struct WorkloadSpec {
+  const char* name;
+  double read;
+  double update;
+  double insert;
+  double scan;
+  double readModifyWrite;
+  bool latest;  // reads favor recently inserted keys (workload D)
+};
+
+static const WorkloadSpec kYcsbWorkloads[] = {
+    {"a", 0.50, 0.50, 0, 0, 0, false}, {"b", 0.95, 0.05, 0, 0, 0, false},
+    {"c", 1.00, 0, 0, 0, 0, false},    {"d", 0.95, 0, 0.05, 0, 0, true},
+    {"e", 0, 0, 0.05, 0.95, 0, false}, {"f", 0.50, 0, 0, 0, 0.50, false}};
+
+/* Zipfian distribution over [0, n) as generated by YCSB, the most popular
+item is 0. */
+class ZipfianGenerator {
+ public:
+  ZipfianGenerator(uint64_t n, double theta) : n_(n), theta_(theta) {
+    zetan_ = zeta(n);
+    alpha_ = 1.0 / (1.0 - theta);
+    eta_ = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta(2) / zetan_);
+  }
+
+  uint64_t next(double u) {
+    double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + pow(0.5, theta_)) {
+      return 1;
+    }
+    uint64_t val = n_ * pow(eta_ * u - eta_ + 1, alpha_);
+    return std::min(val, n_ - 1);
+  }
+
+ private:
+  double zeta(uint64_t n) {
+    double sum = 0;
+    for (uint64_t i = 0; i < n; i++) {
+      sum += 1 / pow(i + 1, theta_);
+    }
+    return sum;
+  }
+
+  uint64_t n_;
+  double theta_;
+  double zetan_;
+  double alpha_;
+  double eta_;
+};
+
+/* Spreads the popular items over the key space like YCSB's scrambled
+zipfian, so they do not all sit at the start of the table. */
+static uint64_t ScrambleKey(uint64_t val, uint64_t n) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < 8; i++) {
+    hash ^= (val >> (i * 8)) & 0xff;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash % n;
+}
+
+/* Latencies of one kind of operation. */
+struct OpStats {
+  OpStats() : errors(0) {}
+  std::vector<uint64_t> nanos;
+  uint64_t errors;
+};
+
+struct Options {
+  Options()
+      : workload("a"),
+        records(1000),
+        ops(1000),
+        fields(10),
+        fieldLen(100),
+        threads(0),
+        seed(1) {}
+
+  std::string workload;
+  size_t records;
+  size_t ops;
+  size_t fields;
+  size_t fieldLen;
+  size_t threads;
+  uint64_t seed;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+class Driver {
+ public:
+  Driver(Options& opts) : opts_(opts), rand_(opts.seed) {}
+
+  bool runYcsb(const WorkloadSpec& spec);
+  bool runTpch();
+
+ private:
+  bool exec(const std::string& stmt, OpStats& stats);
+  bool execTimed(const std::string& stmt, const char* op);
+  double uniform() { return std::uniform_real_distribution<double>()(rand_); }
+  std::string randomString(size_t len);
+  std::string ycsbInsert(uint64_t key);
+  void report(const char* phase, size_t ops, double seconds);
+
+  Options& opts_;
+  std::mt19937_64 rand_;
+  std::map<std::string, OpStats> stats_;
+};
+
+bool Driver::exec(const std::string& stmt, OpStats& stats) {
+  if (ExecStmt(stmt)) {
+    stats.errors++;
+    return true;
+  }
+  return false;
+}
+
+bool Driver::execTimed(const std::string& stmt, const char* op) {
+  OpStats& stats = stats_[op];
+  Clock::time_point start = Clock::now();
+  bool ret = exec(stmt, stats);
+  stats.nanos.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            Clock::now() - start)
+                            .count());
+  return ret;
+}
+
+std::string Driver::randomString(size_t len) {
+  std::string str(len, ' ');
+  for (auto& ch : str) {
+    ch = 'a' + rand_() % 26;
+  }
+  return str;
+}
+
+std::string Driver::ycsbInsert(uint64_t key) {
+  std::string stmt =
+      "insert into " YCSB_TABLE " values (" + std::to_string(key);
+  for (size_t i = 0; i < opts_.fields; i++) {
+    stmt += ", '" + randomString(opts_.fieldLen) + "'";
+  }
+  return stmt + ")";
+}
+
+bool Driver::runYcsb(const WorkloadSpec& spec) {
+  std::string create = "create table " YCSB_TABLE " (ycsb_key int";
+  for (size_t i = 0; i < opts_.fields; i++) {
+    create += ", field" + std::to_string(i) + " char(" +
+              std::to_string(opts_.fieldLen) + ")";
+  }
+  OpStats ddl;
+  if (exec(create + ")", ddl)) {
+    return true;
+  }
+
+  Clock::time_point start = Clock::now();
+  for (size_t key = 0; key < opts_.records; key++) {
+    execTimed(ycsbInsert(key), "insert");
+  }
+  report("load", opts_.records,
+         std::chrono::duration<double>(Clock::now() - start).count());
+  stats_.clear();
+
+  ZipfianGenerator zipf(std::max<size_t>(opts_.records, 2), ZIPFIAN_THETA);
+  uint64_t key_num = opts_.records;
+  start = Clock::now();
+  for (size_t i = 0; i < opts_.ops; i++) {
+    uint64_t key = 0;
+    uint64_t rank = zipf.next(uniform());
+    if (spec.latest) {
+      key = (rank < key_num) ? key_num - 1 - rank : 0;
+    } else {
+      key = ScrambleKey(rank, key_num);
+    }
+    std::string where = " where ycsb_key = " + std::to_string(key);
+    std::string field = "field" + std::to_string(rand_() % opts_.fields);
+
+    double op = uniform();
+    if ((op -= spec.read) < 0) {
+      execTimed("select * from " YCSB_TABLE + where, "read");
+    } else if ((op -= spec.update) < 0) {
+      execTimed("update " YCSB_TABLE " set " + field + " = '" +
+                    randomString(opts_.fieldLen) + "'" + where,
+                "update");
+    } else if ((op -= spec.insert) < 0) {
+      execTimed(ycsbInsert(key_num++), "insert");
+    } else if ((op -= spec.scan) < 0) {
+      execTimed("select * from " YCSB_TABLE " where field0 = '" +
+                    randomString(opts_.fieldLen) + "'",
+                "scan");
+    } else {
+      /* Read-modify-write is timed as one operation. */
+      OpStats& stats = stats_["read_modify_write"];
+      Clock::time_point op_start = Clock::now();
+      exec("select * from " YCSB_TABLE + where, stats);
+      exec("update " YCSB_TABLE " set " + field + " = '" +
+               randomString(opts_.fieldLen) + "'" + where,
+           stats);
+      stats.nanos.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                               op_start)
+              .count());
+    }
+  }
+  report("run", opts_.ops,
+         std::chrono::duration<double>(Clock::now() - start).count());
+  return false;
+}
+
+/* A lineitem table filled with values from the TPC-H domains. The engine has
+no joins or aggregates yet, so the analytical mix is made of the scans and
+selective filters such queries start with. */
+bool Driver::runTpch() {
+  static const char* kShipModes[] = {"REG AIR", "AIR", "RAIL", "SHIP",
+                                     "TRUCK",   "MAIL", "FOB"};
+  static const char* kReturnFlags[] = {"R", "A", "N"};
+
+  OpStats ddl;
+  if (exec("create table " TPCH_TABLE
+           " (l_orderkey int, l_partkey int, l_suppkey int, l_linenumber int,"
+           " l_quantity int, l_extendedprice long, l_discount int,"
+           " l_returnflag char(1), l_linestatus char(1), l_shipmode char(10))",
+           ddl)) {
+    return true;
+  }
+
+  Clock::time_point start = Clock::now();
+  size_t orders = std::max<size_t>(opts_.records / 4, 1);
+  for (size_t i = 0; i < opts_.records; i++) {
+    uint64_t quantity = 1 + rand_() % 50;
+    uint64_t price = quantity * (90000 + rand_() % 20000);
+    std::string stmt = "insert into " TPCH_TABLE " values (" +
+                       std::to_string(i / 4) + ", " +
+                       std::to_string(rand_() % 200000) + ", " +
+                       std::to_string(rand_() % 10000) + ", " +
+                       std::to_string(i % 4 + 1) + ", " +
+                       std::to_string(quantity) + ", " +
+                       std::to_string(price) + ", " +
+                       std::to_string(rand_() % 11) + ", '" +
+                       kReturnFlags[rand_() % 3] + "', '" +
+                       (rand_() % 2 ? "O" : "F") + "', '" +
+                       kShipModes[rand_() % 7] + "')";
+    execTimed(stmt, "insert");
+  }
+  report("load", opts_.records,
+         std::chrono::duration<double>(Clock::now() - start).count());
+  stats_.clear();
+
+  start = Clock::now();
+  for (size_t i = 0; i < opts_.ops; i++) {
+    switch (rand_() % 4) {
+      case 0:
+        execTimed(std::string("select l_orderkey, l_extendedprice from "
+                              TPCH_TABLE " where l_shipmode = '") +
+                      kShipModes[rand_() % 7] + "'",
+                  "shipmode");
+        break;
+      case 1:
+        execTimed(std::string("select * from " TPCH_TABLE
+                              " where l_returnflag = '") +
+                      kReturnFlags[rand_() % 3] + "'",
+                  "returnflag");
+        break;
+      case 2:
+        execTimed("select l_orderkey, l_partkey from " TPCH_TABLE
+                  " where l_quantity = " +
+                      std::to_string(1 + rand_() % 50),
+                  "quantity");
+        break;
+      default:
+        execTimed("select * from " TPCH_TABLE " where l_orderkey = " +
+                      std::to_string(rand_() % orders),
+                  "order");
+        break;
+    }
+  }
+  report("run", opts_.ops,
+         std::chrono::duration<double>(Clock::now() - start).count());
+  return false;
+}
+
+static double Percentile(std::vector<uint64_t>& sorted, double p) {
+  size_t idx = std::min<size_t>(sorted.size() * p, sorted.size() - 1);
+  return sorted[idx] / 1000.0;
+}
+
+/* One JSON object per line: the throughput of the phase, then the latency
+percentiles of each kind of operation in microseconds. */
+void Driver::report(const char* phase, size_t ops, double seconds) {
+  printf(
+      "{\"workload\": \"%s\", \"phase\": \"%s\", \"ops\": %zu, "
+      "\"seconds\": %.3f, \"ops_per_sec\": %.1f}\n",
+      opts_.workload.c_str(), phase, ops, seconds,
+      seconds > 0 ? ops / seconds : 0);
+
+  for (auto& iter : stats_) {
+    std::vector<uint64_t>& nanos = iter.second.nanos;
+    if (nanos.empty()) {
+      continue;
+    }
+    std::sort(nanos.begin(), nanos.end());
+    double sum = 0;
+    for (auto n : nanos) {
+      sum += n;
+    }
+    printf(
+        "{\"workload\": \"%s\", \"phase\": \"%s\", \"op\": \"%s\", "
+        "\"count\": %zu, \"errors\": %lu, \"avg_us\": %.1f, "
+        "\"p50_us\": %.1f, \"p95_us\": %.1f, \"p99_us\": %.1f, "
+        "\"p999_us\": %.1f, \"max_us\": %.1f}\n",
+        opts_.workload.c_str(), phase, iter.first.c_str(), nanos.size(),
+        (unsigned long)iter.second.errors, sum / nanos.size() / 1000.0,
+        Percentile(nanos, 0.50), Percentile(nanos, 0.95),
+        Percentile(nanos, 0.99), Percentile(nanos, 0.999),
+        nanos.back() / 1000.0);
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+  Options opts;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--workload" && i + 1 < argc) {
+      opts.workload = argv[++i];
+    } else if (arg == "--records" && i + 1 < argc) {
+      opts.records = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--ops" && i + 1 < argc) {
+      opts.ops = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--fields" && i + 1 < argc) {
+      opts.fields = std::max<size_t>(strtoul(argv[++i], nullptr, 10), 1);
+    } else if (arg == "--field-length" && i + 1 < argc) {
+      opts.fieldLen = std::max<size_t>(strtoul(argv[++i], nullptr, 10), 1);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      opts.threads = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      opts.seed = strtoull(argv[++i], nullptr, 10);
+    } else {
+      std::cout << "Usage: " << argv[0]
+                << " [--workload a|b|c|d|e|f|tpch] [--records <num>]"
+                   " [--ops <num>] [--fields <num>] [--field-length <num>]"
+                   " [--threads <num>] [--seed <num>]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  const WorkloadSpec* spec = nullptr;
+  for (auto& ycsb : kYcsbWorkloads) {
+    if (opts.workload == ycsb.name) {
+      spec = &ycsb;
+    }
+  }
+  if (spec == nullptr && opts.workload != "tpch") {
+    std::cout << "Unknown workload " << opts.workload << std::endl;
+    return 1;
+  }
+
+  g_scheduler.start(opts.threads, false);
+  NullBuffer null_buf;
+  std::streambuf* old_buf = std::cout.rdbuf(&null_buf);
+
+  Driver driver(opts);
+  bool ret = (spec != nullptr) ? driver.runYcsb(*spec) : driver.runTpch();
+
+  std::cout.rdbuf(old_buf);
+  g_scheduler.stop();
+  if (ret) {
+    std::cout << "Failed to create the tables of workload " << opts.workload
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
\ No newline at end of file
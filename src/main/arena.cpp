@@ -0,0 +1,55 @@
+#include "arena.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace bydb {
+
+void* Arena::allocate(size_t size, size_t align) {
+  uintptr_t ptr = reinterpret_cast<uintptr_t>(ptr_);
+  uintptr_t aligned = (ptr + align - 1) & ~(align - 1);
+
+  if (ptr_ == nullptr || aligned + size > reinterpret_cast<uintptr_t>(end_)) {
+    /* Large requests get a block of their own. */
+    size_t block_size = size + align;
+    block_size = (block_size > ARENA_BLOCK_SIZE) ? block_size
+                                                 : ARENA_BLOCK_SIZE;
+    char* block = static_cast<char*>(malloc(block_size));
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+    blocks_.push_back(block);
+    ptr_ = block;
+    end_ = block + block_size;
+    ptr = reinterpret_cast<uintptr_t>(ptr_);
+    aligned = (ptr + align - 1) & ~(align - 1);
+  }
+
+  ptr_ = reinterpret_cast<char*>(aligned + size);
+  bytes_ += size;
+  return reinterpret_cast<void*>(aligned);
+}
+
+char* Arena::strdup(const char* str, size_t len) {
+  char* dup = static_cast<char*>(allocate(len + 1, 1));
+  memcpy(dup, str, len);
+  dup[len] = '\0';
+  return dup;
+}
+
+void Arena::reset() {
+  for (auto iter = finalizers_.rbegin(); iter != finalizers_.rend(); iter++) {
+    iter->func(iter->obj);
+  }
+  finalizers_.clear();
+
+  for (auto block : blocks_) {
+    free(block);
+  }
+  blocks_.clear();
+  ptr_ = nullptr;
+  end_ = nullptr;
+  bytes_ = 0;
+}
+
+}  // namespace bydb
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bydb {
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* A bump allocator owning everything a statement allocates: plans,
+operators, expressions and intermediate values. All of it is released at
+once when the arena is destroyed. Not thread safe, parallel tasks fill their
+own arena, which can itself be created in the statement's arena. */
+class Arena {
+ public:
+  Arena() : ptr_(nullptr), end_(nullptr), bytes_(0) {}
+  ~Arena() { reset(); }
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(size_t size, size_t align = alignof(std::max_align_t));
+  char* strdup(const char* str, size_t len);
+
+  /* Objects with a destructor get it called when the arena is released. */
+  template <typename T, typename... Args>
+  T* create(Args&&... args) {
+    T* obj = alloc<T>(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value) {
+      finalizers_.push_back({&destroy<T>, obj});
+    }
+    return obj;
+  }
+
+  /* The destructor is never called, for objects whose members are allocated
+  from the arena as well. */
+  template <typename T, typename... Args>
+  T* alloc(Args&&... args) {
+    void* mem = allocate(sizeof(T), alignof(T));
+    return new (mem) T(std::forward<Args>(args)...);
+  }
+
+  void reset();
+
+  size_t bytesAllocated() { return bytes_; }
+
+ private:
+  struct Finalizer {
+    void (*func)(void*);
+    void* obj;
+  };
+
+  template <typename T>
+  static void destroy(void* obj) {
+    static_cast<T*>(obj)->~T();
+  }
+
+  std::vector<char*> blocks_;
+  std::vector<Finalizer> finalizers_;
+  char* ptr_;
+  char* end_;
+  size_t bytes_;
+};
+
+/* Lets std containers take their memory from an arena. Freeing is a no-op,
+the memory goes away with the arena. */
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  ArenaAllocator(Arena* arena) : arena_(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* ptr, size_t n) {}
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+}  // namespace bydb
@@ -0,0 +1,86 @@
+#include "compactor.h"
+#include "epoch.h"
+#include "metadata.h"
+#include "scheduler.h"
+#include "trx.h"
+
+#include <mutex>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace bydb {
+
+Compactor g_compactor;
+
+static std::mutex s_storage_mutex;
+/* Set while the thread runs a statement. */
+static thread_local bool t_in_statement = false;
+
+StorageGuard::StorageGuard() {
+  s_storage_mutex.lock();
+  t_in_statement = true;
+}
+
+StorageGuard::~StorageGuard() {
+  t_in_statement = false;
+  s_storage_mutex.unlock();
+}
+
+void Compactor::schedule() {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (pending_.load() ||
+      (!woken_.load() &&
+       now - lastPass_ < std::chrono::milliseconds(interval_))) {
+    return;
+  }
+
+  lastPass_ = now;
+  woken_ = false;
+  pending_ = true;
+  g_scheduler.submit([this]() {
+    runPass();
+    pending_ = false;
+  });
+}
+
+void Compactor::runPass() {
+  /* A statement waiting for its parallel scan may run this task itself, the
+  pass is skipped then rather than blocking on the statement. */
+  if (t_in_statement) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(s_storage_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+
+  EpochGuard guard;
+  std::vector<Table*> tables;
+  g_meta_data.getAllTables(&tables);
+
+  size_t freed_num = 0;
+  size_t dict_num = 0;
+  for (auto table : tables) {
+    for (auto partition : *table->partitions()) {
+      TableStore* table_store = partition->getTableStore();
+      freed_num += table_store->compact();
+      /* Frozen rows and dictionary codes never change, so nothing may
+      freeze or recode what an open transaction could still roll back. */
+      if (!g_transaction.inTransaction()) {
+        dict_num += table_store->checkDicts();
+        frozenGroups_ += table_store->freeze();
+      }
+    }
+  }
+  freedGroups_ += freed_num;
+
+#ifdef __GLIBC__
+  /* free() keeps small blocks in the heap, hand them back. */
+  if (freed_num > 0 || dict_num > 0) {
+    malloc_trim(0);
+  }
+#endif
+}
+
+}  // namespace bydb
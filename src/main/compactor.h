@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace bydb {
+
+#define COMPACT_INTERVAL_MS 1000
+
+/* Held by a statement while it runs, the compactor only moves tuples when
+no statement holds it. */
+class StorageGuard {
+ public:
+  StorageGuard();
+  ~StorageGuard();
+  StorageGuard(const StorageGuard&) = delete;
+  StorageGuard& operator=(const StorageGuard&) = delete;
+};
+
+/* Background maintenance of table storage. A pass empties and frees sparse
+tuple groups, see TableStore::compact(), and gives the memory back to the
+OS. Outside transactions it also freezes the tuple groups nothing was written
+to since the previous pass, see TableStore::freeze(), and checks the string
+dictionaries that grew too big, see TableStore::checkDicts(). Passes run as
+tasks on g_scheduler, at most one every interval unless a table woke the
+compactor, and are skipped while a statement is running. */
+class Compactor {
+ public:
+  Compactor()
+      : interval_(COMPACT_INTERVAL_MS),
+        pending_(false),
+        woken_(false),
+        frozenGroups_(0),
+        freedGroups_(0) {}
+
+  void setInterval(uint64_t ms) { interval_ = ms; }
+
+  /* Called after every statement, submits a pass if one is due. */
+  void schedule();
+  /* The next schedule() submits a pass whatever the interval. */
+  void wake() { woken_ = true; }
+  void runPass();
+
+  size_t frozenGroups() { return frozenGroups_.load(); }
+  size_t freedGroups() { return freedGroups_.load(); }
+
+ private:
+  uint64_t interval_;
+  std::atomic<bool> pending_;
+  std::atomic<bool> woken_;
+  std::atomic<size_t> frozenGroups_;  // by all passes so far
+  std::atomic<size_t> freedGroups_;
+  std::chrono::steady_clock::time_point lastPass_;
+};
+
+extern Compactor g_compactor;
+
+}  // namespace bydb
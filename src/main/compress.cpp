@@ -0,0 +1,203 @@
+#include "compress.h"
+
+#include <algorithm>
+
+namespace bydb {
+
+static uint8_t BitWidth(uint64_t val) {
+  return (val == 0) ? 0 : 64 - __builtin_clzll(val);
+}
+
+static size_t PackedBytes(size_t num, uint8_t width) {
+  return (num * width + 63) / 64 * sizeof(uint64_t);
+}
+
+/* Differences are taken on unsigned values, which wrap instead of
+overflowing, and added back the same way. */
+static uint64_t Diff(int64_t a, int64_t b) {
+  return static_cast<uint64_t>(a) - static_cast<uint64_t>(b);
+}
+
+static int64_t Add(int64_t a, uint64_t b) {
+  return static_cast<int64_t>(static_cast<uint64_t>(a) + b);
+}
+
+IntSegment* IntSegment::Encode(const int64_t* vals, size_t num) {
+  IntSegment* seg = new IntSegment();
+  seg->num_ = num;
+  if (num == 0) {
+    return seg;
+  }
+
+  int64_t min = vals[0];
+  int64_t max = vals[0];
+  size_t runs = 1;
+  for (size_t i = 1; i < num; i++) {
+    min = std::min(min, vals[i]);
+    max = std::max(max, vals[i]);
+    runs += (vals[i] != vals[i - 1]);
+  }
+  seg->min_ = min;
+  seg->max_ = max;
+
+  /* Deltas are only taken between rows of the same checkpoint, and only
+  used if none of them overflows. */
+  bool delta_ok = true;
+  int64_t delta_min = INT64_MAX;
+  int64_t delta_max = INT64_MIN;
+  for (size_t i = 1; i < num; i++) {
+    if (i % DELTA_CHECKPOINT == 0) {
+      continue;
+    }
+    int64_t delta = 0;
+    if (__builtin_sub_overflow(vals[i], vals[i - 1], &delta)) {
+      delta_ok = false;
+      break;
+    }
+    delta_min = std::min(delta_min, delta);
+    delta_max = std::max(delta_max, delta);
+  }
+  if (delta_min > delta_max) {
+    delta_min = delta_max = 0;
+  }
+
+  uint8_t for_width = BitWidth(Diff(max, min));
+  uint8_t delta_width = BitWidth(Diff(delta_max, delta_min));
+  size_t for_bytes = PackedBytes(num, for_width);
+  size_t delta_bytes = PackedBytes(num, delta_width) +
+                       (num + DELTA_CHECKPOINT - 1) / DELTA_CHECKPOINT *
+                           sizeof(int64_t);
+  size_t rle_bytes = PackedBytes(runs, for_width) + runs * sizeof(uint32_t);
+
+  std::vector<uint64_t> packed;
+  if (rle_bytes < for_bytes && (!delta_ok || rle_bytes < delta_bytes)) {
+    seg->encoding_ = kEncodingRle;
+    for (size_t i = 0; i < num; i++) {
+      if (i + 1 == num || vals[i + 1] != vals[i]) {
+        packed.push_back(Diff(vals[i], min));
+        seg->runEnds_.push_back(i + 1);
+      }
+    }
+    seg->pack(packed, for_width);
+  } else if (delta_ok && delta_bytes < for_bytes) {
+    seg->encoding_ = kEncodingDelta;
+    seg->deltaMin_ = delta_min;
+    for (size_t i = 0; i < num; i++) {
+      if (i % DELTA_CHECKPOINT == 0) {
+        seg->bases_.push_back(vals[i]);
+        packed.push_back(0);
+      } else {
+        packed.push_back(Diff(Diff(vals[i], vals[i - 1]), delta_min));
+      }
+    }
+    seg->pack(packed, delta_width);
+  } else {
+    seg->encoding_ = kEncodingFor;
+    for (size_t i = 0; i < num; i++) {
+      packed.push_back(Diff(vals[i], min));
+    }
+    seg->pack(packed, for_width);
+  }
+
+  return seg;
+}
+
+void IntSegment::pack(const std::vector<uint64_t>& vals, uint8_t width) {
+  width_ = width;
+  words_.assign(PackedBytes(vals.size(), width) / sizeof(uint64_t), 0);
+  if (width == 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < vals.size(); i++) {
+    size_t bit = i * width;
+    size_t word = bit / 64;
+    size_t shift = bit % 64;
+    words_[word] |= vals[i] << shift;
+    if (shift + width > 64) {
+      words_[word + 1] |= vals[i] >> (64 - shift);
+    }
+  }
+}
+
+uint64_t IntSegment::unpack(size_t idx) const {
+  if (width_ == 0) {
+    return 0;
+  }
+
+  size_t bit = idx * width_;
+  size_t word = bit / 64;
+  size_t shift = bit % 64;
+  uint64_t val = words_[word] >> shift;
+  if (shift + width_ > 64) {
+    val |= words_[word + 1] << (64 - shift);
+  }
+  return (width_ == 64) ? val : val & ((1ULL << width_) - 1);
+}
+
+int64_t IntSegment::get(size_t idx) const {
+  switch (encoding_) {
+    case kEncodingFor:
+      return Add(min_, unpack(idx));
+    case kEncodingDelta: {
+      size_t base = idx / DELTA_CHECKPOINT;
+      int64_t val = bases_[base];
+      for (size_t i = base * DELTA_CHECKPOINT + 1; i <= idx; i++) {
+        val = Add(Add(val, unpack(i)), deltaMin_);
+      }
+      return val;
+    }
+    case kEncodingRle: {
+      size_t run = std::upper_bound(runEnds_.begin(), runEnds_.end(), idx) -
+                   runEnds_.begin();
+      return Add(min_, unpack(run));
+    }
+    default:
+      return 0;
+  }
+}
+
+/* Rows before 'begin' are only read back to its delta checkpoint, or
+searched for the run 'begin' is in. */
+void IntSegment::decode(int64_t* vals, size_t begin, size_t num) const {
+  size_t end = begin + num;
+  switch (encoding_) {
+    case kEncodingFor:
+      for (size_t i = begin; i < end; i++) {
+        vals[i - begin] = Add(min_, unpack(i));
+      }
+      break;
+    case kEncodingDelta: {
+      int64_t val = 0;
+      for (size_t i = begin / DELTA_CHECKPOINT * DELTA_CHECKPOINT; i < end;
+           i++) {
+        val = (i % DELTA_CHECKPOINT == 0)
+                  ? bases_[i / DELTA_CHECKPOINT]
+                  : Add(Add(val, unpack(i)), deltaMin_);
+        if (i >= begin) {
+          vals[i - begin] = val;
+        }
+      }
+      break;
+    }
+    case kEncodingRle: {
+      size_t run =
+          std::upper_bound(runEnds_.begin(), runEnds_.end(), begin) -
+          runEnds_.begin();
+      for (size_t i = begin; i < end; i++) {
+        run += (i == runEnds_[run]);
+        vals[i - begin] = Add(min_, unpack(run));
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+size_t IntSegment::memoryUsage() const {
+  return sizeof(IntSegment) + words_.size() * sizeof(uint64_t) +
+         bases_.size() * sizeof(int64_t) + runEnds_.size() * sizeof(uint32_t);
+}
+
+}  // namespace bydb
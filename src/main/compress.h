@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bydb {
+
+/* Deltas keep an absolute value every this many rows, so reading one value
+never sums more than this many deltas. */
+#define DELTA_CHECKPOINT 32
+
+enum IntEncoding { kEncodingFor, kEncodingDelta, kEncodingRle };
+
+/* The INT or LONG values of one column of a frozen tuple group, compressed
+with whichever of frame of reference, delta or run length encoding is the
+smallest. Every encoding bit-packs its integers at the width of the largest
+one. Single values can be read without decompressing the segment, scans
+decode the whole segment once instead. */
+class IntSegment {
+ public:
+  static IntSegment* Encode(const int64_t* vals, size_t num);
+
+  /* For random access, a delta value costs up to DELTA_CHECKPOINT
+  unpacks. */
+  int64_t get(size_t idx) const;
+  /* One unpack per value. */
+  void decode(int64_t* vals) const { decode(vals, 0, num_); }
+  void decode(int64_t* vals, size_t begin, size_t num) const;
+
+  /* Lets filters skip rows of a segment without reading them. */
+  bool mayContain(int64_t val) const { return val >= min_ && val <= max_; }
+
+  IntEncoding encoding() const { return encoding_; }
+  size_t memoryUsage() const;
+
+ private:
+  IntSegment()
+      : encoding_(kEncodingFor),
+        num_(0),
+        min_(0),
+        max_(0),
+        deltaMin_(0),
+        width_(0) {}
+
+  void pack(const std::vector<uint64_t>& vals, uint8_t width);
+  uint64_t unpack(size_t idx) const;
+
+  IntEncoding encoding_;
+  size_t num_;
+  int64_t min_;
+  int64_t max_;
+  int64_t deltaMin_;  // delta: added to every unpacked delta
+  uint8_t width_;     // bits per packed integer
+  std::vector<uint64_t> words_;
+  std::vector<int64_t> bases_;     // delta: value at every checkpoint
+  std::vector<uint32_t> runEnds_;  // rle: end of every run, exclusive
+};
+
+}  // namespace bydb
@@ -0,0 +1,87 @@
+#include "engine.h"
+#include "compactor.h"
+#include "epoch.h"
+#include "executor.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "plan_cache.h"
+#include "result_cache.h"
+
+#include <iostream>
+
+using namespace hsql;
+
+namespace bydb {
+
+static bool RunStmt(std::string& stmt) {
+  /* Hot DML skips parsing and planning by running a cached plan with the
+  literals of this query bound to it. Queries the cache can not plan go the
+  normal way, which reports their errors. */
+  Arena arena;
+  std::string key;
+  std::vector<Expr*> params;
+  if (PlanCache::normalize(stmt, &key, &params, &arena)) {
+    CachedPlan* cached = g_plan_cache.getPlan(key);
+    if (cached != nullptr && cached->paramNum == params.size()) {
+      return g_result_cache.run(key, cached->plan, &params, &arena);
+    }
+    if (cached != nullptr) {
+      std::cout << "[BYDB-Error]  Cached plan of '" << key << "' takes "
+                << cached->paramNum << " parameters but " << params.size()
+                << " were found, planning it again." << std::endl;
+    }
+  }
+
+  Parser parser;
+  if (parser.parseStatement(stmt)) {
+    return true;
+  }
+
+  /* Statements hsql does not know about are parsed by ourselves. */
+  const ExtStatement* ext_stmt = parser.getExtStatement();
+  if (ext_stmt != nullptr) {
+    Optimizer optimizer(&arena);
+    Plan* plan = optimizer.createExtPlanTree(ext_stmt);
+    if (plan == nullptr) {
+      return true;
+    }
+
+    Executor executor(plan, &arena);
+    executor.init();
+    return executor.exec();
+  }
+
+  for (auto bound : parser.getBoundStatements()) {
+    /* Everything the statement allocates is released with its arena. */
+    Arena stmt_arena;
+    Optimizer optimizer(&stmt_arena);
+    Plan* plan = optimizer.createPlanTree(bound);
+    if (plan == nullptr) {
+      return true;
+    }
+
+    Executor executor(plan, &stmt_arena);
+    executor.init();
+    if (executor.exec()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ExecStmt(std::string stmt) {
+  bool ret = false;
+  {
+    StorageGuard storage_guard;
+    /* Keeps every table and index looked up alive until the statement is
+    done. */
+    EpochGuard guard;
+    ret = RunStmt(stmt);
+  }
+
+  g_compactor.schedule();
+  return ret;
+}
+
+}  // namespace bydb
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+namespace bydb {
+
+/* Parses, plans and executes one line of SQL, returns true on error. Used by
+the shell as well as by the workload driver, which runs the engine
+in-process. */
+bool ExecStmt(std::string stmt);
+
+}  // namespace bydb
\ No newline at end of file
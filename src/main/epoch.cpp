@@ -0,0 +1,117 @@
+#include "epoch.h"
+
+#include <thread>
+
+namespace bydb {
+
+EpochManager g_epoch;
+
+/* The slot of the calling thread, released again when the thread exits. */
+struct ThreadSlot {
+  ThreadSlot() : idx(-1), depth(0) {}
+  ~ThreadSlot();
+
+  int idx;
+  size_t depth;
+};
+
+static thread_local ThreadSlot t_slot;
+
+EpochManager::EpochManager() : epoch_(1), retiredNum_(0) {
+  for (size_t i = 0; i < EPOCH_MAX_THREADS; i++) {
+    slots_[i] = 0;
+    used_[i] = false;
+  }
+}
+
+EpochManager::~EpochManager() {
+  for (auto& retired : retired_) {
+    retired.deleter(retired.obj);
+  }
+}
+
+size_t EpochManager::claimSlot() {
+  while (true) {
+    for (size_t i = 0; i < EPOCH_MAX_THREADS; i++) {
+      bool expected = false;
+      if (!used_[i].load() &&
+          used_[i].compare_exchange_strong(expected, true)) {
+        return i;
+      }
+    }
+    std::this_thread::yield();
+  }
+}
+
+void EpochManager::releaseSlot(size_t idx) {
+  slots_[idx].store(0);
+  used_[idx].store(false);
+}
+
+ThreadSlot::~ThreadSlot() {
+  if (idx >= 0) {
+    g_epoch.releaseSlot(idx);
+  }
+}
+
+void EpochManager::pin() {
+  if (t_slot.depth++ > 0) {
+    return;
+  }
+
+  if (t_slot.idx < 0) {
+    t_slot.idx = claimSlot();
+  }
+  /* Anything retired from now on has an epoch no smaller than this one. */
+  slots_[t_slot.idx].store(epoch_.load());
+}
+
+void EpochManager::unpin() {
+  if (t_slot.depth == 0 || --t_slot.depth > 0) {
+    return;
+  }
+
+  slots_[t_slot.idx].store(0);
+  if (retiredNum_.load() > 0) {
+    reclaim();
+  }
+}
+
+void EpochManager::retire(void* obj, void (*deleter)(void*)) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  retired_.push_back({obj, deleter, epoch_.fetch_add(1)});
+  retiredNum_++;
+}
+
+/* Objects retired at epoch 'e' may still be held by readers that pinned an
+epoch up to 'e', those pinned later only see what replaced them. */
+void EpochManager::reclaim() {
+  uint64_t min_epoch = UINT64_MAX;
+  for (size_t i = 0; i < EPOCH_MAX_THREADS; i++) {
+    uint64_t epoch = slots_[i].load();
+    if (epoch != 0 && epoch < min_epoch) {
+      min_epoch = epoch;
+    }
+  }
+
+  std::vector<Retired> freed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t kept = 0;
+    for (auto& retired : retired_) {
+      if (retired.epoch < min_epoch) {
+        freed.push_back(retired);
+      } else {
+        retired_[kept++] = retired;
+      }
+    }
+    retired_.resize(kept);
+    retiredNum_ = kept;
+  }
+
+  for (auto& retired : freed) {
+    retired.deleter(retired.obj);
+  }
+}
+
+}  // namespace bydb
\ No newline at end of file
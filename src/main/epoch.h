@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace bydb {
+
+#define EPOCH_MAX_THREADS 256
+
+struct ThreadSlot;
+
+/* Epoch based reclamation for objects shared without locks, such as the
+catalog. Readers pin the current epoch while they use shared objects, which
+is a store to their own slot. Writers unlink an object and retire it, it is
+freed once every reader pinned before the retirement has unpinned. */
+class EpochManager {
+ public:
+  EpochManager();
+  ~EpochManager();
+
+  /* Pins nest, only the outermost pin of a thread counts. */
+  void pin();
+  void unpin();
+
+  /* Frees 'obj' once no pinned reader can still hold it. */
+  template <typename T>
+  void retire(T* obj) {
+    retire(obj, &destroy<T>);
+  }
+  void retire(void* obj, void (*deleter)(void*));
+
+  void reclaim();
+
+ private:
+  struct Retired {
+    void* obj;
+    void (*deleter)(void*);
+    uint64_t epoch;
+  };
+
+  template <typename T>
+  static void destroy(void* obj) {
+    delete static_cast<T*>(obj);
+  }
+
+  friend struct ThreadSlot;
+  size_t claimSlot();
+  void releaseSlot(size_t idx);
+
+  std::atomic<uint64_t> epoch_;
+  std::atomic<uint64_t> slots_[EPOCH_MAX_THREADS];  // pinned epoch, 0 if idle
+  std::atomic<bool> used_[EPOCH_MAX_THREADS];
+  std::mutex mutex_;  // protects retired_
+  std::vector<Retired> retired_;
+  std::atomic<size_t> retiredNum_;
+};
+
+extern EpochManager g_epoch;
+
+/* Pins the epoch for its scope. */
+class EpochGuard {
+ public:
+  EpochGuard() { g_epoch.pin(); }
+  ~EpochGuard() { g_epoch.unpin(); }
+  EpochGuard(const EpochGuard&) = delete;
+  EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+}  // namespace bydb
\ No newline at end of file
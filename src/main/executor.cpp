@@ -1,78 +1,381 @@
 #include "executor.h"
 #include "metadata.h"
 #include "optimizer.h"
+#include "plan_cache.h"
+#include "result_cache.h"
+#include "scheduler.h"
 #include "trx.h"
 #include "util.h"
 
+#include <chrono>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 using namespace hsql;
 
 namespace bydb {
 
-void Executor::init() { opTree_ = generateOperator(planTree_); }
+size_t g_distinct_memory = DISTINCT_MEMORY_DEFAULT;
 
-bool Executor::exec() { return opTree_->exec(); }
+/* One line of EXPLAIN, 'parallel' for a scan run by ParallelSeqScanOperator
+which the filter plan on top of it is folded into. */
+static std::string PlanToString(Plan* plan, bool parallel) {
+  std::string str;
+  Plan* scan = plan;
+  if (parallel) {
+    scan = (plan->planType == kFilter) ? plan->next : plan;
+    str = "ParallelSeqScan";
+  } else if (plan->planType == kScan) {
+    str = "SeqScan";
+  } else if (plan->planType == kSetOp) {
+    SetOpPlan* set_op = static_cast<SetOpPlan*>(plan);
+    str = SetTypeToString(set_op->type);
+    str += set_op->all ? " All" : "";
+  } else if (plan->planType == kSemiJoin) {
+    str = static_cast<SemiJoinPlan*>(plan)->anti ? "Hash Anti Join"
+                                                 : "Hash Semi Join";
+  } else {
+    str = PlanTypeToString(plan->planType);
+  }
+
+  Table* table = nullptr;
+  switch (scan->planType) {
+    case kInsert:
+      table = static_cast<InsertPlan*>(scan)->table;
+      break;
+    case kUpdate:
+      table = static_cast<UpdatePlan*>(scan)->table;
+      break;
+    case kDelete:
+      table = static_cast<DeletePlan*>(scan)->table;
+      break;
+    case kSelect:
+      table = static_cast<SelectPlan*>(scan)->table;
+      break;
+    case kScan:
+      table = static_cast<ScanPlan*>(scan)->table;
+      break;
+    case kProjection:
+      table = static_cast<ProjectionPlan*>(scan)->table;
+      break;
+    case kSemiJoin:
+      table = static_cast<SemiJoinPlan*>(scan)->table;
+      break;
+    default:
+      break;
+  }
+  if (table != nullptr) {
+    str += " " + TableNameToString(table->schema(), table->name());
+  }
+
+  if (scan->planType == kScan) {
+    ScanPlan* scan_plan = static_cast<ScanPlan*>(scan);
+    Expr* val = scan_plan->pruneVal;
+    if (val != nullptr && val->type != kExprParameter) {
+      int idx = table->partitionOf(val);
+      str += (idx < 0) ? ", no partition"
+                       : ", partition " + (*table->partitions())[idx]->name();
+    }
+  }
+
+  if (plan->planType == kSemiJoin) {
+    SemiJoinPlan* join = static_cast<SemiJoinPlan*>(plan);
+    if (join->keyed) {
+      str += " on ";
+      str += (*join->table->columns())[join->idx]->name;
+    }
+  }
+
+  if (plan->planType == kLimit) {
+    LimitPlan* limit = static_cast<LimitPlan*>(plan);
+    if (limit->limit != nullptr) {
+      str += " " + LiteralToString(limit->limit);
+    }
+    if (limit->offset != nullptr) {
+      str += " offset " + LiteralToString(limit->offset);
+    }
+  }
+
+  if (plan->planType == kFilter) {
+    FilterPlan* filter = static_cast<FilterPlan*>(plan);
+    str += parallel ? ", Filter " : " ";
+    str += (*filter->table->columns())[filter->idx]->name;
+    str += " = " + LiteralToString(filter->val);
+  }
+  return str;
+}
+
+static std::string PlanLine(int depth, std::string& label, Plan* plan) {
+  std::ostringstream line;
+  line << std::string(depth * 4, ' ') << (depth > 0 ? "->  " : "") << label
+       << "  (rows=" << std::fixed << std::setprecision(0) << plan->rows
+       << " cost=" << std::setprecision(2) << plan->cost << ")";
+  return line.str();
+}
+
+/* The second input of the plans having one, null for the others. */
+static Plan* RightPlan(Plan* plan) {
+  if (plan->planType == kSetOp) {
+    return static_cast<SetOpPlan*>(plan)->right;
+  }
+  if (plan->planType == kSemiJoin) {
+    return static_cast<SemiJoinPlan*>(plan)->right;
+  }
+  return nullptr;
+}
+
+/* Selects only read, their parallel scans can hand out rows while workers
+still scan the table. */
+void Executor::init() {
+  Plan* plan = planTree_;
+  if (plan->planType == kExplain) {
+    plan = static_cast<ExplainPlan*>(plan)->plan;
+  }
+  pipelined_ = (plan->planType == kSelect);
+  opTree_ = generateOperator(planTree_);
+}
+
+bool Executor::exec() {
+  if (opTree_ == nullptr) {
+    return true;
+  }
+  /* Inputs left unread by an error may have tasks running, they finish
+  before the statement's arena is released. */
+  bool ret = opTree_->exec();
+  opTree_->stop();
+  return ret;
+}
+
+/* The value of LIMIT or OFFSET, 'none' without one. Returns true if it is
+not a non-negative integer. */
+static bool LimitValue(ExecContext* ctx, Expr* expr, uint64_t none,
+                       uint64_t* val) {
+  *val = none;
+  if (expr == nullptr) {
+    return false;
+  }
+  Expr* bound = ctx->bind(expr);
+  if (bound->type == kExprLiteralNull) {
+    return false;
+  }
+  if (bound->type != kExprLiteralInt || bound->ival < 0) {
+    return true;
+  }
+  *val = bound->ival;
+  return false;
+}
 
-BaseOperator* Executor::generateOperator(Plan* plan) {
+/* At most how many rows 'plan' reads from its input when 'limit' rows are
+read from it, -1 for all of them. Only limits, projections and filters pass
+a limit on, a filter as many rows as it is estimated to need for it. */
+static double InputLimit(Plan* plan, double limit, ExecContext* ctx) {
+  switch (plan->planType) {
+    case kLimit: {
+      LimitPlan* limit_plan = static_cast<LimitPlan*>(plan);
+      uint64_t count = 0;
+      uint64_t offset = 0;
+      if (LimitValue(ctx, limit_plan->limit, UINT64_MAX, &count) ||
+          LimitValue(ctx, limit_plan->offset, 0, &offset)) {
+        return -1;
+      }
+      if (limit < 0 || limit > count) {
+        if (count == UINT64_MAX) {
+          return -1;
+        }
+        limit = count;
+      }
+      return limit + offset;
+    }
+    case kProjection:
+      return limit;
+    case kFilter:
+      if (limit < 0 || plan->rows <= 0) {
+        return -1;
+      }
+      return limit * plan->next->rows / plan->rows;
+    default:
+      return -1;
+  }
+}
+
+/* The stores of the partitions a scan has to visit. */
+static void ScanStores(ScanPlan* scan, ExecContext* ctx,
+                       std::vector<TableStore*>* stores) {
+  const std::vector<Partition*>* parts = scan->table->partitions();
+  if (scan->pruneVal == nullptr) {
+    for (auto partition : *parts) {
+      stores->push_back(partition->getTableStore());
+    }
+    return;
+  }
+
+  int idx = scan->table->partitionOf(ctx->bind(scan->pruneVal));
+  if (idx >= 0) {
+    stores->push_back((*parts)[idx]->getTableStore());
+  }
+}
+
+/* Big tables are scanned in parallel. The plan may be cached, so the choice
+is costed with the live tuple count and the current number of workers. A
+serial scan stops after the 'limit' rows read from it, a parallel one walks
+the whole table to split it into morsels first. */
+bool Executor::useParallelScan(Plan* scan, ExecContext* ctx, double limit) {
+  if (scan == nullptr || scan->planType != kScan ||
+      static_cast<ScanPlan*>(scan)->type != kSeqScan) {
+    return false;
+  }
+
+  std::vector<TableStore*> stores;
+  ScanStores(static_cast<ScanPlan*>(scan), ctx, &stores);
+  double rows = 0;
+  for (auto table_store : stores) {
+    rows += table_store->tupleCount();
+  }
+  double serial = (limit < 0) ? rows : std::min(rows, limit);
+  return Optimizer::parallelScanCost(rows, g_scheduler.threadNum()) <
+         Optimizer::seqScanCost(serial);
+}
+
+/* 'limit' is the number of rows at most read from 'plan', -1 for all. */
+BaseOperator* Executor::generateOperator(Plan* plan, double limit) {
   BaseOperator* op = nullptr;
   BaseOperator* next = nullptr;
+  double input_limit = InputLimit(plan, limit, &ctx_);
+
+  /* The filter on top of a parallel scan is pushed down into the workers. */
+  Plan* scan = (plan->planType == kFilter) ? plan->next : plan;
+  if (useParallelScan(scan, &ctx_, (plan == scan) ? limit : input_limit)) {
+    FilterPlan* filter =
+        (plan == scan) ? nullptr : static_cast<FilterPlan*>(plan);
+    op = ctx_.arena->create<ParallelSeqScanOperator>(scan, filter, pipelined_,
+                                                     &ctx_);
+    return profile(op, plan, PlanToString(plan, true));
+  }
 
   /* Build Operator tree from the leaf. */
   if (plan->next != nullptr) {
-    next = generateOperator(plan->next);
+    next = generateOperator(plan->next, input_limit);
   }
 
+  Arena* arena = ctx_.arena;
   switch (plan->planType) {
     case kCreate:
-      op = new CreateOperator(plan, next);
+      op = arena->create<CreateOperator>(plan, next, &ctx_);
       break;
     case kDrop:
-      op = new DropOperator(plan, next);
+      op = arena->create<DropOperator>(plan, next, &ctx_);
       break;
     case kInsert:
-      op = new InsertOperator(plan, next);
+      op = arena->create<InsertOperator>(plan, next, &ctx_);
       break;
     case kUpdate:
-      op = new UpdateOperator(plan, next);
+      op = arena->create<UpdateOperator>(plan, next, &ctx_);
       break;
     case kDelete:
-      op = new DeleteOperator(plan, next);
+      op = arena->create<DeleteOperator>(plan, next, &ctx_);
       break;
     case kSelect:
-      op = new SelectOperator(plan, next);
+      op = arena->create<SelectOperator>(plan, next, &ctx_);
       break;
     case kScan: {
       ScanPlan* scan_plan = static_cast<ScanPlan*>(plan);
       if (scan_plan->type == kSeqScan) {
-        op = new SeqScanOperator(plan, next);
+        op = arena->create<SeqScanOperator>(plan, next, &ctx_);
       }
       break;
     }
     case kFilter:
-      op = new FilterOperator(plan, next);
+      op = arena->create<FilterOperator>(plan, next, &ctx_);
+      break;
+    case kProjection:
+      op = arena->create<ProjectionOperator>(plan, next, &ctx_);
+      break;
+    case kDistinct:
+      op = arena->create<DistinctOperator>(plan, next, &ctx_);
       break;
+    case kLimit:
+      op = arena->create<LimitOperator>(plan, next, &ctx_);
+      break;
+    case kSetOp:
+    case kSemiJoin: {
+      BaseOperator* right = generateOperator(RightPlan(plan));
+      if (next == nullptr || right == nullptr) {
+        return nullptr;
+      }
+      if (plan->planType == kSetOp) {
+        op = arena->create<SetOpOperator>(plan, next, right, &ctx_);
+      } else {
+        op = arena->create<SemiJoinOperator>(plan, next, right, &ctx_);
+      }
+      break;
+    }
     case kTrx:
-      op = new TrxOperator(plan, next);
+      op = arena->create<TrxOperator>(plan, next, &ctx_);
       break;
     case kShow:
-      op = new ShowOperator(plan, next);
+      op = arena->create<ShowOperator>(plan, next, &ctx_);
+      break;
+    case kPrepare:
+      op = arena->create<PrepareOperator>(plan, next, &ctx_);
+      break;
+    case kExecute:
+      op = arena->create<ExecuteOperator>(plan, next, &ctx_);
+      break;
+    case kAnalyze:
+      op = arena->create<AnalyzeOperator>(plan, next, &ctx_);
+      break;
+    case kTruncate:
+      op = arena->create<TruncateOperator>(plan, next, &ctx_);
+      break;
+    case kPartition:
+      op = arena->create<PartitionOperator>(plan, next, &ctx_);
       break;
+    case kExplain: {
+      /* Only EXPLAIN ANALYZE runs the statement, with every operator
+      wrapped to measure it. */
+      ExplainPlan* explain = static_cast<ExplainPlan*>(plan);
+      if (explain->analyze) {
+        ctx_.analyze = true;
+        profile_ = true;
+        next = generateOperator(explain->plan);
+        profile_ = false;
+        if (next == nullptr) {
+          return nullptr;
+        }
+      }
+      op = arena->create<ExplainOperator>(plan, next, &ctx_);
+      break;
+    }
     default:
       std::cout << "[BYDB-Error]  Not support plan node "
                 << PlanTypeToString(plan->planType);
       break;
   }
 
-  return op;
+  if (op == nullptr) {
+    return nullptr;
+  }
+  return profile(op, plan, PlanToString(plan, false));
+}
+
+BaseOperator* Executor::profile(BaseOperator* op, Plan* plan,
+                                std::string label) {
+  if (!profile_) {
+    return op;
+  }
+  return ctx_.arena->create<ProfileOperator>(op, plan, label, &ctx_);
 }
 
 bool CreateOperator::exec(TupleIter** iter) {
   CreatePlan* plan = static_cast<CreatePlan*>(plan_);
 
   if (plan->type == kCreateTable) {
-    Table* table = new Table(plan->schema, plan->tableName, plan->columns);
+    Table* table = new Table(plan->schema, plan->tableName, plan->columns,
+                             plan->partition);
     if (g_meta_data.insertTable(table)) {
+      delete table;
       if (plan->ifNotExists) {
         std::cout << "[BYDB-Info]  Table "
                   << TableNameToString(plan->schema, plan->tableName)
@@ -84,7 +387,6 @@ bool CreateOperator::exec(TupleIter** iter) {
                   << " already existed." << std::endl;
         return true;
       }
-      delete table;
     }
 
     std::cout << "[BYDB-Info]  Create table successfully." << std::endl;
@@ -112,7 +414,7 @@ bool CreateOperator::exec(TupleIter** iter) {
     index = new Index();
     index->name = plan->indexName;
     index->columns = *plan->indexColumns;
-    table->addIndex(index);
+    g_meta_data.insertIndex(table, index);
     std::cout << "[BYDB-Info]  Create index successfully." << std::endl;
   } else {
     std::cout << "[BYDB-Error]  Invalid 'Show' statement." << std::endl;
@@ -122,8 +424,19 @@ bool CreateOperator::exec(TupleIter** iter) {
   return false;
 }
 
+/* A truncate undo points to the partition, which a dropped table takes
+along, so tables can not be dropped until the truncate commits or rolls
+back. */
 bool DropOperator::exec(TupleIter** iter) {
   DropPlan* plan = static_cast<DropPlan*>(plan_);
+  if ((plan->type == kDropSchema || plan->type == kDropTable) &&
+      g_transaction.hasTruncated()) {
+    std::cout << "[BYDB-Error]  Tables can not be dropped in a transaction "
+                 "which truncated one."
+              << std::endl;
+    return true;
+  }
+
   if (plan->type == kDropSchema) {
     if (g_meta_data.dropSchema(plan->schema)) {
       if (plan->ifExists) {
@@ -156,6 +469,22 @@ bool DropOperator::exec(TupleIter** iter) {
 
     std::cout << "[BYDB-Info]  Drop schema successfully." << std::endl;
     return false;
+  } else if (plan->type == kDropPreparedStatement) {
+    if (g_plan_cache.deallocate(plan->name)) {
+      if (plan->ifExists) {
+        std::cout << "[BYDB-Info]  Prepared statement " << plan->name
+                  << " did not exist." << std::endl;
+        return false;
+      } else {
+        std::cout << "[BYDB-Error]  Prepared statement " << plan->name
+                  << " did not exist." << std::endl;
+        return true;
+      }
+    }
+
+    std::cout << "[BYDB-Info]  Deallocate prepared statement successfully."
+              << std::endl;
+    return false;
   } else if (plan->type == kDropIndex) {
     if (g_meta_data.dropIndex(plan->schema, plan->name, plan->indexName)) {
       if (plan->ifExists) {
@@ -181,20 +510,103 @@ bool DropOperator::exec(TupleIter** iter) {
 
 bool InsertOperator::exec(TupleIter** iter) {
   InsertPlan* plan = static_cast<InsertPlan*>(plan_);
-  TableStore* table_store = plan->table->getTableStore();
-  if (table_store->insertTuple(plan->values)) {
+  Table* table = plan->table;
+  std::vector<ColumnDefinition*>* columns = table->columns();
+
+  std::vector<Expr*> values;
+  for (size_t i = 0; i < plan->values.size(); i++) {
+    Expr* value = ctx_->bind(plan->values[i]);
+    if (value != plan->values[i] && CheckColumnValue((*columns)[i], value)) {
+      return true;
+    }
+    values.push_back(value);
+  }
+
+  int idx = 0;
+  if (table->partitionColumn() >= 0) {
+    idx = table->partitionOf(values[table->partitionColumn()]);
+  }
+  if (idx < 0) {
+    std::cout << "[BYDB-Error]  No partition of table "
+              << TableNameToString(table->schema(), table->name())
+              << " holds the row." << std::endl;
+    return true;
+  }
+
+  TableStore* table_store = (*table->partitions())[idx]->getTableStore();
+  if (table_store->insertTuple(&values)) {
     return true;
   }
   std::cout << "[BYDB-Info]  Insert tuple successfully." << std::endl;
   return false;
 }
 
+/* Frozen tuples are never changed in place, the groups holding a tuple the
+statement is going to change are thawed before its scan starts. */
+static bool ThawForChange(Plan* plan, ExecContext* ctx) {
+  /* Which rows a subquery matches is only known while they are scanned, the
+  groups are thawed whole. */
+  if (plan->planType == kSemiJoin) {
+    plan = plan->next;
+  }
+  FilterPlan* filter = nullptr;
+  if (plan->planType == kFilter) {
+    filter = static_cast<FilterPlan*>(plan);
+    plan = plan->next;
+  }
+  std::vector<TableStore*> stores;
+  ScanStores(static_cast<ScanPlan*>(plan), ctx, &stores);
+
+  EqualFilter equal;
+  if (filter != nullptr) {
+    equal.init(filter, ctx->bind(filter->val));
+  }
+  FrozenCursor cursor;
+  for (auto table_store : stores) {
+    if (table_store->frozenCount() == 0) {
+      continue;
+    }
+    if (filter == nullptr) {
+      if (table_store->thaw(nullptr)) {
+        return true;
+      }
+      continue;
+    }
+
+    bool ret = table_store->thaw([&](Tuple* tup) {
+      if (equal.raw()) {
+        return equal.matchTuple(table_store, tup, &cursor);
+      }
+      TupleIter iter(tup, table_store, ctx->arena);
+      table_store->parseTuple(tup, iter.values, ctx->arena, &cursor);
+      return equal.match(&iter);
+    });
+    if (ret) {
+      return true;
+    }
+  }
+  return false;
+}
+
 bool UpdateOperator::exec(TupleIter** iter) {
   UpdatePlan* update = static_cast<UpdatePlan*>(plan_);
   Table* table = update->table;
-  TableStore* table_store = table->getTableStore();
   int upd_cnt = 0;
 
+  std::vector<Expr*> values;
+  for (size_t i = 0; i < update->values.size(); i++) {
+    Expr* value = ctx_->bind(update->values[i]);
+    ColumnDefinition* col_def = (*table->columns())[update->idxs[i]];
+    if (value != update->values[i] && CheckColumnValue(col_def, value)) {
+      return true;
+    }
+    values.push_back(value);
+  }
+
+  if (ThawForChange(plan_->next, ctx_)) {
+    return true;
+  }
+
   while (true) {
     TupleIter* tup_iter = nullptr;
     if (next_->exec(&tup_iter)) {
@@ -204,7 +616,7 @@ bool UpdateOperator::exec(TupleIter** iter) {
     if (tup_iter == nullptr) {
       break;
     } else {
-      table_store->updateTuple(tup_iter->tup, update->idxs, update->values);
+      tup_iter->store->updateTuple(tup_iter->tup, update->idxs, values);
       upd_cnt++;
     }
   }
@@ -215,10 +627,12 @@ bool UpdateOperator::exec(TupleIter** iter) {
 }
 
 bool DeleteOperator::exec(TupleIter** iter) {
-  Table* table = static_cast<DeletePlan*>(plan_)->table;
-  TableStore* table_store = table->getTableStore();
   int del_cnt = 0;
 
+  if (ThawForChange(plan_->next, ctx_)) {
+    return true;
+  }
+
   while (true) {
     TupleIter* tup_iter = nullptr;
     if (next_->exec(&tup_iter)) {
@@ -228,7 +642,7 @@ bool DeleteOperator::exec(TupleIter** iter) {
     if (tup_iter == nullptr) {
       break;
     } else {
-      table_store->deleteTuple(tup_iter->tup);
+      tup_iter->store->deleteTuple(tup_iter->tup);
       del_cnt++;
     }
   }
@@ -301,9 +715,160 @@ bool ShowOperator::exec(TupleIter** iter) {
   return false;
 }
 
+bool PrepareOperator::exec(TupleIter** iter) {
+  PreparePlan* plan = static_cast<PreparePlan*>(plan_);
+  if (g_plan_cache.prepare(plan->name, plan->query)) {
+    return true;
+  }
+
+  std::cout << "[BYDB-Info]  Prepare statement successfully." << std::endl;
+  return false;
+}
+
+bool ExecuteOperator::exec(TupleIter** iter) {
+  ExecutePlan* plan = static_cast<ExecutePlan*>(plan_);
+  CachedPlan* prepared = g_plan_cache.getPrepared(plan->name);
+  if (prepared == nullptr) {
+    std::cout << "[BYDB-Error]  Failed to find prepared statement "
+              << plan->name << std::endl;
+    return true;
+  }
+
+  /* The parameters are bound to the prepared plan as they are, no query
+  text is parsed again. */
+  return g_result_cache.run(prepared->query, prepared->plan, &plan->params,
+                            ctx_->arena);
+}
+
+bool AnalyzeOperator::exec(TupleIter** iter) {
+  AnalyzePlan* plan = static_cast<AnalyzePlan*>(plan_);
+  g_meta_data.updateStats(plan->table, AnalyzeTable(plan->table));
+  std::cout << "[BYDB-Info]  Analyze table successfully." << std::endl;
+  return false;
+}
+
+/* The tuples are not visited, every partition gets an empty store and the
+old one is freed as a whole, or kept by a single undo entry inside a
+transaction. The statistics are dropped, which also makes cached plans
+stale. */
+bool TruncateOperator::exec(TupleIter** iter) {
+  TruncatePlan* plan = static_cast<TruncatePlan*>(plan_);
+  for (auto partition : *plan->table->partitions()) {
+    TableStore* table_store = partition->truncate();
+    if (g_transaction.inTransaction()) {
+      g_transaction.addTruncateUndo(partition, table_store);
+    } else {
+      delete table_store;
+    }
+  }
+  g_meta_data.updateStats(plan->table, nullptr);
+  std::cout << "[BYDB-Info]  Truncate table successfully." << std::endl;
+  return false;
+}
+
+/* A dropped partition takes its rows along, which is only a change of the
+partition list. Undo entries may point into its store, so a transaction
+can not drop partitions. */
+bool PartitionOperator::exec(TupleIter** iter) {
+  PartitionPlan* plan = static_cast<PartitionPlan*>(plan_);
+  Table* table = plan->table;
+  if (!plan->drop) {
+    g_meta_data.addPartition(
+        table, new Partition(plan->name, plan->bound, table->columns()));
+    std::cout << "[BYDB-Info]  Add partition successfully." << std::endl;
+    return false;
+  }
+
+  if (g_transaction.inTransaction()) {
+    std::cout << "[BYDB-Error]  Partitions can not be dropped in a "
+                 "transaction."
+              << std::endl;
+    return true;
+  }
+  if (g_meta_data.dropPartition(table, plan->name.c_str())) {
+    std::cout << "[BYDB-Error]  Partition " << plan->name << " did not exist!"
+              << std::endl;
+    return true;
+  }
+  g_meta_data.updateStats(table, nullptr);
+  std::cout << "[BYDB-Info]  Drop partition successfully." << std::endl;
+  return false;
+}
+
+/* The right input of a plan is printed below its left one. Scans are
+labelled the way the executor would run them under the limits above. */
+static void ExplainPlanTree(Plan* plan, int depth, ExecContext* ctx,
+                            double limit) {
+  bool parallel = Executor::useParallelScan(plan, ctx, limit);
+  std::string label = PlanToString(plan, parallel);
+  std::cout << PlanLine(depth, label, plan) << std::endl;
+  if (plan->next != nullptr) {
+    ExplainPlanTree(plan->next, depth + 1, ctx,
+                    InputLimit(plan, limit, ctx));
+  }
+  if (RightPlan(plan) != nullptr) {
+    ExplainPlanTree(RightPlan(plan), depth + 1, ctx, -1);
+  }
+}
+
+bool ExplainOperator::exec(TupleIter** iter) {
+  ExplainPlan* plan = static_cast<ExplainPlan*>(plan_);
+  if (plan->analyze) {
+    if (next_->exec()) {
+      return true;
+    }
+    static_cast<ProfileOperator*>(next_)->print(0);
+    return false;
+  }
+
+  ExplainPlanTree(plan->plan, 0, ctx_, -1);
+  return false;
+}
+
+bool ProfileOperator::exec(TupleIter** iter) {
+  size_t bytes = ctx_->arena->bytesAllocated();
+  uint64_t cycles = ReadCycleCounter();
+  auto start = std::chrono::steady_clock::now();
+
+  bool ret = op_->exec(iter);
+
+  nanos_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  cycles_ += ReadCycleCounter() - cycles;
+  bytes_ += ctx_->arena->bytesAllocated() - bytes;
+  batches_++;
+
+  if (iter == nullptr) {
+    /* Select, Update and Delete drain their input in a single call. */
+    if (next_ != nullptr) {
+      rows_ = static_cast<ProfileOperator*>(next_)->rows_;
+    }
+  } else if (*iter != nullptr) {
+    rows_++;
+  }
+  return ret;
+}
+
+void ProfileOperator::print(int depth) {
+  std::ostringstream line;
+  line << PlanLine(depth, label_, plan_) << " (actual rows=" << rows_
+       << " batches=" << batches_ << " time=" << std::fixed
+       << std::setprecision(3) << nanos_ / 1000000.0 << " ms cycles=" << cycles_
+       << " memory=" << bytes_ + op_->ownArenaBytes() << " B)";
+  std::cout << line.str() << std::endl;
+  if (next_ != nullptr) {
+    static_cast<ProfileOperator*>(next_)->print(depth + 1);
+  }
+  if (RightPlan(plan_) != nullptr) {
+    BaseOperator* right = static_cast<BinaryOperator*>(op_)->right();
+    static_cast<ProfileOperator*>(right)->print(depth + 1);
+  }
+}
+
 bool SelectOperator::exec(TupleIter** iter) {
   SelectPlan* plan = static_cast<SelectPlan*>(plan_);
-  std::vector<std::vector<Expr*>> tuples;
+  TupleIterList tuples(ctx_->arena);
   while (true) {
     TupleIter* tup_iter = nullptr;
     if (next_->exec(&tup_iter)) {
@@ -313,47 +878,650 @@ bool SelectOperator::exec(TupleIter** iter) {
     if (tup_iter == nullptr) {
       break;
     } else {
-      tuples.push_back(tup_iter->values);
+      tuples.push_back(tup_iter);
     }
   }
 
-  PrintTuples(plan->outCols, plan->colIds, tuples);
+  if (!ctx_->analyze) {
+    if (ctx_->resultKey != nullptr) {
+      g_result_cache.insert(*ctx_->resultKey, plan, tuples, ctx_->arena);
+    }
+    PrintTuples(plan->outCols, plan->colIds, tuples);
+  }
   return false;
 }
 
-bool SeqScanOperator::exec(TupleIter** iter) {
-  ScanPlan* plan = static_cast<ScanPlan*>(plan_);
-  TableStore* table_store = plan->table->getTableStore();
-  Tuple* tup = nullptr;
+bool ProjectionOperator::exec(TupleIter** iter) {
+  ProjectionPlan* plan = static_cast<ProjectionPlan*>(plan_);
+  TupleIter* tup_iter = nullptr;
+  *iter = nullptr;
+  if (next_->exec(&tup_iter)) {
+    return true;
+  }
+  if (tup_iter == nullptr) {
+    return false;
+  }
 
-  if (finish) {
+  TupleIter* projected = ctx_->arena->alloc<TupleIter>(
+      tup_iter->tup, tup_iter->store, ctx_->arena);
+  for (auto col_id : plan->colIds) {
+    projected->values.push_back(tup_iter->values[col_id]);
+  }
+  *iter = projected;
+  return false;
+}
+
+size_t RowHash::operator()(const TupleIter* iter) const {
+  size_t hash = 0;
+  for (auto val : iter->values) {
+    size_t val_hash = 0;
+    if (val->type == kExprLiteralInt) {
+      val_hash = std::hash<int64_t>()(val->ival);
+    } else if (val->type == kExprLiteralString) {
+      val_hash = BKDRHash(val->name, strlen(val->name));
+    }
+    hash = hash * 31 + val_hash;
+  }
+  return hash;
+}
+
+bool RowEqual::operator()(const TupleIter* a, const TupleIter* b) const {
+  for (size_t i = 0; i < a->values.size(); i++) {
+    Expr* val_a = a->values[i];
+    Expr* val_b = b->values[i];
+    if (val_a->type != val_b->type) {
+      return false;
+    }
+    if (val_a->type == kExprLiteralInt && val_a->ival != val_b->ival) {
+      return false;
+    }
+    if (val_a->type == kExprLiteralString &&
+        strcmp(val_a->name, val_b->name) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SetOpOperator::buildRight() {
+  while (true) {
+    TupleIter* tup_iter = nullptr;
+    if (right_->exec(&tup_iter)) {
+      return true;
+    }
+    if (tup_iter == nullptr) {
+      return false;
+    }
+    rows_[tup_iter]++;
+  }
+}
+
+/* Counts of the right rows are used up by INTERSECT ALL and EXCEPT ALL.
+The distinct forms remember the rows returned with a count of zero. */
+bool SetOpOperator::keep(TupleIter* iter) {
+  SetOpPlan* plan = static_cast<SetOpPlan*>(plan_);
+  if (plan->type == kSetUnion) {
+    return plan->all || rows_.emplace(iter, 0).second;
+  }
+
+  auto found = rows_.find(iter);
+  if (plan->type == kSetIntersect) {
+    if (found == rows_.end() || found->second == 0) {
+      return false;
+    }
+    found->second = plan->all ? found->second - 1 : 0;
+    return true;
+  }
+
+  if (!plan->all) {
+    return rows_.emplace(iter, 0).second;
+  }
+  if (found != rows_.end() && found->second > 0) {
+    found->second--;
+    return false;
+  }
+  return true;
+}
+
+bool SetOpOperator::exec(TupleIter** iter) {
+  SetOpPlan* plan = static_cast<SetOpPlan*>(plan_);
+  if (!started_) {
+    started_ = true;
+    if (plan->type != kSetUnion && buildRight()) {
+      return true;
+    }
+  }
+
+  *iter = nullptr;
+  while (true) {
+    TupleIter* tup_iter = nullptr;
+    BaseOperator* input = leftDone_ ? right_ : next_;
+    if (input->exec(&tup_iter)) {
+      return true;
+    }
+
+    if (tup_iter == nullptr) {
+      if (plan->type == kSetUnion && !leftDone_) {
+        leftDone_ = true;
+        continue;
+      }
+      return false;
+    }
+
+    if (keep(tup_iter)) {
+      *iter = tup_iter;
+      return false;
+    }
+  }
+}
+
+bool SemiJoinOperator::build() {
+  SemiJoinPlan* plan = static_cast<SemiJoinPlan*>(plan_);
+  probe_ = ctx_->arena->alloc<TupleIter>(nullptr, nullptr, ctx_->arena);
+  probe_->values.push_back(nullptr);
+  while (true) {
+    TupleIter* tup_iter = nullptr;
+    if (right_->exec(&tup_iter)) {
+      return true;
+    }
+    if (tup_iter == nullptr) {
+      return false;
+    }
+
+    /* The rest of the subquery is not needed when its first row or NULL
+    decides for every row. */
+    empty_ = false;
+    if (!plan->keyed) {
+      right_->stop();
+      return false;
+    }
+    if (tup_iter->values[0]->type == kExprLiteralNull) {
+      hasNull_ = true;
+      if (plan->nullAware) {
+        right_->stop();
+        return false;
+      }
+      continue;
+    }
+    keys_.insert(tup_iter);
+  }
+}
+
+bool SemiJoinOperator::exec(TupleIter** iter) {
+  SemiJoinPlan* plan = static_cast<SemiJoinPlan*>(plan_);
+  if (!started_) {
+    started_ = true;
+    if (build()) {
+      return true;
+    }
+  }
+
+  /* Some subqueries decide for every row at once, no row is read if they
+  leave none. */
+  *iter = nullptr;
+  bool keep_all = false;
+  if (!plan->keyed) {
+    keep_all = (empty_ == plan->anti);
+  } else if (plan->nullAware && (empty_ || hasNull_)) {
+    keep_all = empty_;
+  } else {
+    while (true) {
+      TupleIter* tup_iter = nullptr;
+      if (next_->exec(&tup_iter)) {
+        return true;
+      }
+      if (tup_iter == nullptr) {
+        return false;
+      }
+
+      Expr* val = tup_iter->values[plan->idx];
+      bool keep = false;
+      if (val->type == kExprLiteralNull) {
+        keep = plan->anti && !plan->nullAware;
+      } else {
+        probe_->values[0] = val;
+        keep = (keys_.count(probe_) > 0) != plan->anti;
+      }
+      if (keep) {
+        *iter = tup_iter;
+        return false;
+      }
+    }
+  }
+
+  if (!keep_all) {
     return false;
   }
+  return next_->exec(iter);
+}
+
+bool LimitOperator::exec(TupleIter** iter) {
+  LimitPlan* plan = static_cast<LimitPlan*>(plan_);
+  if (!started_) {
+    started_ = true;
+    if (LimitValue(ctx_, plan->limit, UINT64_MAX, &limit_) ||
+        LimitValue(ctx_, plan->offset, 0, &offset_)) {
+      std::cout << "[BYDB-Error]  LIMIT and OFFSET should be non-negative "
+                   "integers."
+                << std::endl;
+      return true;
+    }
+  }
+
+  /* LIMIT 0 does not read any row. */
+  *iter = nullptr;
+  while (returned_ < limit_) {
+    TupleIter* tup_iter = nullptr;
+    if (next_->exec(&tup_iter)) {
+      return true;
+    }
+    if (tup_iter == nullptr) {
+      break;
+    }
+    if (offset_ > 0) {
+      offset_--;
+      continue;
+    }
+
+    *iter = tup_iter;
+    if (++returned_ == limit_) {
+      next_->stop();
+    }
+    break;
+  }
 
-  if (nextTuple_ == nullptr) {
-    tup = table_store->seqScan(nullptr);
+  return false;
+}
+
+/* A row as the bytes of its values, which compare equal if the values do.
+Every value starts with its type, strings with their length as well. */
+void EncodeRow(TupleIter* iter, std::string* key) {
+  for (auto val : iter->values) {
+    if (val->type == kExprLiteralInt) {
+      key->push_back('i');
+      key->append(reinterpret_cast<const char*>(&val->ival), sizeof(int64_t));
+    } else if (val->type == kExprLiteralString) {
+      uint32_t len = strlen(val->name);
+      key->push_back('s');
+      key->append(reinterpret_cast<const char*>(&len), sizeof(uint32_t));
+      key->append(val->name, len);
+    } else {
+      key->push_back('n');
+    }
+  }
+}
+
+TupleIter* DecodeRow(const std::string& key, Arena* arena) {
+  TupleIter* iter = arena->alloc<TupleIter>(nullptr, nullptr, arena);
+  const char* pos = key.data();
+  const char* end = pos + key.size();
+  while (pos < end) {
+    Expr* val = nullptr;
+    char type = *pos++;
+    if (type == 'i') {
+      val = arena->alloc<Expr>(kExprLiteralInt);
+      memcpy(&val->ival, pos, sizeof(int64_t));
+      pos += sizeof(int64_t);
+    } else if (type == 's') {
+      uint32_t len = 0;
+      memcpy(&len, pos, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      val = arena->alloc<Expr>(kExprLiteralString);
+      val->name = arena->strdup(pos, len);
+      pos += len;
+    } else {
+      val = arena->alloc<Expr>(kExprLiteralNull);
+    }
+    iter->values.push_back(val);
+  }
+  return iter;
+}
+
+static bool WriteSpilledRow(FILE* file, const std::string& key) {
+  uint32_t len = key.size();
+  if (fwrite(&len, sizeof(uint32_t), 1, file) != 1 ||
+      fwrite(key.data(), 1, len, file) != len) {
+    std::cout << "[BYDB-Error]  Failed to spill the rows of DISTINCT."
+              << std::endl;
+    return true;
+  }
+  return false;
+}
+
+/* Sets 'key' empty at the end of the file. Rows are never empty, they hold
+the type of their values. */
+static bool ReadSpilledRow(FILE* file, std::string* key) {
+  uint32_t len = 0;
+  key->clear();
+  if (fread(&len, sizeof(uint32_t), 1, file) != 1) {
+    return false;
+  }
+  key->resize(len);
+  if (fread(&(*key)[0], 1, len, file) != len) {
+    std::cout << "[BYDB-Error]  Failed to read the rows DISTINCT spilled."
+              << std::endl;
+    return true;
+  }
+  return false;
+}
+
+static void CloseSpill(FILE* file) {
+  if (file != nullptr) {
+    fclose(file);
+  }
+}
+
+DistinctOperator::Pass::~Pass() {
+  CloseSpill(input.returned);
+  CloseSpill(input.pending);
+  for (auto& part_spill : spills) {
+    CloseSpill(part_spill.returned);
+    CloseSpill(part_spill.pending);
+  }
+}
+
+DistinctOperator::~DistinctOperator() {
+  for (auto pass : passes_) {
+    delete pass;
+  }
+}
+
+/* The first pass reads the operator below. The others read the rows their
+partition returned before it spilled, then those it did not look at yet. */
+bool DistinctOperator::readRow(Pass* pass, std::string* key, TupleIter** row,
+                               bool* returned) {
+  *row = nullptr;
+  key->clear();
+  if (pass->depth == 0) {
+    *returned = false;
+    if (next_->exec(row)) {
+      return true;
+    }
+    if (*row != nullptr) {
+      EncodeRow(*row, key);
+    }
   } else {
-    tup = nextTuple_;
+    *returned = true;
+    if (ReadSpilledRow(pass->input.returned, key)) {
+      return true;
+    }
+    if (key->empty()) {
+      *returned = false;
+      if (ReadSpilledRow(pass->input.pending, key)) {
+        return true;
+      }
+    }
   }
 
-  if (tup == nullptr) {
-    *iter = nullptr;
+  pass->inputDone = key->empty();
+  return false;
+}
+
+/* Writes the largest partition in memory to disk, all of its rows have
+been returned. */
+bool DistinctOperator::spill(Pass* pass) {
+  size_t part = DISTINCT_PARTITIONS;
+  for (size_t i = 0; i < DISTINCT_PARTITIONS; i++) {
+    if (pass->spills[i].returned == nullptr &&
+        (part == DISTINCT_PARTITIONS || pass->bytes[i] > pass->bytes[part])) {
+      part = i;
+    }
+  }
+  if (part == DISTINCT_PARTITIONS) {
     return false;
   }
 
-  TupleIter* tup_iter = new TupleIter(tup);
-  table_store->parseTuple(tup, tup_iter->values);
-  tuples_.push_back(tup_iter);
+  Spill& part_spill = pass->spills[part];
+  part_spill.returned = tmpfile();
+  part_spill.pending = tmpfile();
+  if (part_spill.returned == nullptr || part_spill.pending == nullptr) {
+    std::cout << "[BYDB-Error]  Failed to create a file for DISTINCT to "
+                 "spill to."
+              << std::endl;
+    return true;
+  }
+
+  for (auto& key : pass->rows[part]) {
+    if (WriteSpilledRow(part_spill.returned, key)) {
+      return true;
+    }
+  }
+  std::unordered_set<std::string>().swap(pass->rows[part]);
+  pass->total -= pass->bytes[part];
+  pass->bytes[part] = 0;
+  return false;
+}
+
+/* Once the input of a pass is done, its rows in memory are not needed any
+more. Its spilled partitions get a pass each, the pass ends after them. */
+void DistinctOperator::nextPass(Pass* pass) {
+  for (auto& part_rows : pass->rows) {
+    std::unordered_set<std::string>().swap(part_rows);
+  }
+  pass->total = 0;
+
+  while (pass->nextSpill < DISTINCT_PARTITIONS &&
+         pass->spills[pass->nextSpill].returned == nullptr) {
+    pass->nextSpill++;
+  }
+  if (pass->nextSpill == DISTINCT_PARTITIONS) {
+    delete pass;
+    passes_.pop_back();
+    return;
+  }
+
+  Pass* spilled = new Pass(pass->depth + 1);
+  spilled->input = pass->spills[pass->nextSpill];
+  pass->spills[pass->nextSpill++] = Spill();
+  rewind(spilled->input.returned);
+  rewind(spilled->input.pending);
+  passes_.push_back(spilled);
+}
+
+bool DistinctOperator::exec(TupleIter** iter) {
+  if (!started_) {
+    passes_.push_back(new Pass(0));
+    started_ = true;
+  }
+
+  *iter = nullptr;
+  std::string key;
+  while (!passes_.empty()) {
+    Pass* pass = passes_.back();
+    TupleIter* row = nullptr;
+    bool returned = false;
+    if (readRow(pass, &key, &row, &returned)) {
+      return true;
+    }
+    if (pass->inputDone) {
+      nextPass(pass);
+      continue;
+    }
+
+    size_t hash = std::hash<std::string>()(key);
+    size_t part = (hash >> (pass->depth * DISTINCT_PARTITION_BITS)) %
+                  DISTINCT_PARTITIONS;
+    Spill& part_spill = pass->spills[part];
+    if (part_spill.returned != nullptr) {
+      FILE* file = returned ? part_spill.returned : part_spill.pending;
+      if (WriteSpilledRow(file, key)) {
+        return true;
+      }
+      continue;
+    }
+
+    size_t bytes = key.size() + DISTINCT_ROW_OVERHEAD;
+    auto inserted = pass->rows[part].insert(key);
+    if (!inserted.second) {
+      continue;
+    }
+    if (!returned) {
+      *iter = (row != nullptr) ? row : DecodeRow(key, ctx_->arena);
+    }
+
+    pass->bytes[part] += bytes;
+    pass->total += bytes;
+    if (pass->total > g_distinct_memory && pass->depth < DISTINCT_MAX_DEPTH &&
+        spill(pass)) {
+      return true;
+    }
+    if (*iter != nullptr) {
+      return false;
+    }
+  }
+
+  return false;
+}
+
+/* The next tuple is looked up before the current one is returned, which
+may be deleted by the caller. Partitions are scanned one after the other. */
+bool SeqScanOperator::exec(TupleIter** iter) {
+  if (!started_) {
+    ScanStores(static_cast<ScanPlan*>(plan_), ctx_, &stores_);
+    if (!stores_.empty()) {
+      nextTuple_ = stores_[0]->seqScan(nullptr);
+    }
+    started_ = true;
+  }
+
+  *iter = nullptr;
+  while (nextTuple_ == nullptr) {
+    if (++storeIdx_ >= stores_.size()) {
+      return false;
+    }
+    nextTuple_ = stores_[storeIdx_]->seqScan(nullptr);
+  }
+
+  TableStore* table_store = stores_[storeIdx_];
+  Tuple* tup = nextTuple_;
+  TupleIter* tup_iter =
+      ctx_->arena->alloc<TupleIter>(tup, table_store, ctx_->arena);
+  table_store->parseTuple(tup, tup_iter->values, ctx_->arena, &cursor_);
   *iter = tup_iter;
 
   nextTuple_ = table_store->seqScan(tup);
-  if (nextTuple_ == nullptr) {
-    finish = true;
+  return false;
+}
+
+bool ParallelSeqScanOperator::exec(TupleIter** iter) {
+  if (!started_) {
+    if (filter_ != nullptr) {
+      equal_.init(filter_, ctx_->bind(filter_->val));
+    }
+    scanMorsels();
+    started_ = true;
   }
+
+  /* Morsels are returned in order, each once it is scanned. */
+  *iter = nullptr;
+  while (morselIdx_ < results_.size()) {
+    size_t idx = morselIdx_;
+    if (!done_[idx]) {
+      g_scheduler.waitUntil([this, idx]() { return done_[idx].load(); });
+    }
+    std::vector<TupleIter*>& results = results_[idx];
+    if (pos_ < results.size()) {
+      *iter = results[pos_++];
+      break;
+    }
+    morselIdx_++;
+    pos_ = 0;
+    submitMorsels();
+  }
+
   return false;
 }
 
+void ParallelSeqScanOperator::scanMorsels() {
+  std::vector<TableStore*> stores;
+  ScanStores(static_cast<ScanPlan*>(plan_), ctx_, &stores);
+
+  /* Morsels are cut from the groups of each partition, only the tasks read
+  the tuples. */
+  std::vector<SlotRange> ranges;
+  for (auto table_store : stores) {
+    ranges.clear();
+    table_store->slotRanges(MORSEL_SIZE, &ranges);
+    for (auto& range : ranges) {
+      morsels_.emplace_back(table_store, range);
+    }
+  }
+  results_.resize(morsels_.size());
+  done_.reset(new std::atomic<bool>[morsels_.size()]);
+  for (size_t i = 0; i < morsels_.size(); i++) {
+    arenas_.push_back(ctx_->arena->create<Arena>());
+    done_[i] = false;
+  }
+
+  submitMorsels();
+  if (!pipelined_) {
+    g_scheduler.wait(&group_);
+  }
+}
+
+/* A pipelined scan queues more morsels as rows are returned, so one that is
+stopped early leaves the rest of the table unread. */
+void ParallelSeqScanOperator::submitMorsels() {
+  size_t window = MORSEL_WINDOW * std::max<size_t>(g_scheduler.threadNum(), 1);
+  while (submitted_ < morsels_.size() &&
+         (!pipelined_ || submitted_ < morselIdx_ + window)) {
+    size_t i = submitted_++;
+    g_scheduler.submit([this, i]() { scanMorsel(i); }, &group_);
+  }
+}
+
+/* Running tasks are waited for, the rows they scan live in arenas of the
+statement. */
+void ParallelSeqScanOperator::stop() {
+  stopped_ = true;
+  g_scheduler.wait(&group_);
+}
+
+/* Only read once the tasks are done, every morsel has an arena of its own. */
+size_t ParallelSeqScanOperator::ownArenaBytes() {
+  size_t bytes = 0;
+  for (auto arena : arenas_) {
+    bytes += arena->bytesAllocated();
+  }
+  return bytes;
+}
+
+void ParallelSeqScanOperator::scanMorsel(size_t idx) {
+  if (stopped_) {
+    done_[idx] = true;
+    return;
+  }
+
+  TableStore* table_store = morsels_[idx].first;
+  std::vector<TupleIter*>& results = results_[idx];
+  Arena* arena = arenas_[idx];
+
+  const SlotRange& range = morsels_[idx].second;
+  FrozenCursor cursor;
+  for (Tuple* tup = table_store->rangeScan(range, nullptr); tup != nullptr;
+       tup = table_store->rangeScan(range, tup)) {
+    if (equal_.raw()) {
+      if (!equal_.matchTuple(table_store, tup, &cursor)) {
+        continue;
+      }
+    }
+
+    TupleIter* tup_iter = arena->alloc<TupleIter>(tup, table_store, arena);
+    table_store->parseTuple(tup, tup_iter->values, arena, &cursor);
+    if (filter_ == nullptr || equal_.raw() || equal_.match(tup_iter)) {
+      results.push_back(tup_iter);
+    }
+  }
+  done_[idx] = true;
+}
+
 bool FilterOperator::exec(TupleIter** iter) {
+  FilterPlan* filter = static_cast<FilterPlan*>(plan_);
+  if (!started_) {
+    equal_.init(filter, ctx_->bind(filter->val));
+    started_ = true;
+  }
+
   *iter = nullptr;
   while (true) {
     TupleIter* tup_iter = nullptr;
@@ -365,7 +1533,7 @@ bool FilterOperator::exec(TupleIter** iter) {
       break;
     }
 
-    if (execEqualExpr(tup_iter)) {
+    if (equal_.match(tup_iter, &cursor_)) {
       *iter = tup_iter;
       break;
     }
@@ -374,11 +1542,72 @@ bool FilterOperator::exec(TupleIter** iter) {
   return false;
 }
 
-bool FilterOperator::execEqualExpr(TupleIter* iter) {
-  FilterPlan* filter = static_cast<FilterPlan*>(plan_);
-  Expr* val = filter->val;
-  size_t col_id = filter->idx;
+void EqualFilter::init(FilterPlan* plan, Expr* val) {
+  plan_ = plan;
+  val_ = val;
+  mode_ = kMatchValue;
+  codes_.clear();
+  ColumnDefinition* col = (*plan->table->columns())[plan->idx];
+  const std::vector<Partition*>* parts = plan->table->partitions();
+  bool encoded = false;
+  for (auto part : *parts) {
+    encoded = encoded || part->getTableStore()->getDict(plan->idx) != nullptr;
+  }
+  if (col->type.data_type == DataType::INT ||
+      col->type.data_type == DataType::LONG) {
+    mode_ = kMatchInt;
+    missing_ = (val->type != kExprLiteralInt);
+  } else if (encoded) {
+    mode_ = kMatchChar;
+    missing_ = (val->type != kExprLiteralString);
+    for (size_t i = 0; !missing_ && i < parts->size(); i++) {
+      TableStore* table_store = (*parts)[i]->getTableStore();
+      StringDict* dict = table_store->getDict(plan->idx);
+      uint32_t code = 0;
+      if (dict != nullptr && !dict->lookup(val->name, &code)) {
+        codes_.emplace_back(table_store, code);
+      }
+    }
+  } else if (col->type.data_type == DataType::VARCHAR) {
+    mode_ = kMatchVarString;
+    missing_ = (val->type != kExprLiteralString);
+    if (!missing_) {
+      TableStore::MakeVarString(val->name, &key_);
+    }
+  }
+}
+
+bool EqualFilter::matchTuple(TableStore* table_store, Tuple* tup,
+                             FrozenCursor* cursor) {
+  if (missing_) {
+    return false;
+  }
+  if (mode_ == kMatchInt) {
+    return table_store->matchInt(tup, plan_->idx, val_->ival, cursor);
+  }
+  if (mode_ == kMatchChar) {
+    if (table_store->getDict(plan_->idx) == nullptr) {
+      return table_store->matchChar(tup, plan_->idx, val_->name);
+    }
+    for (auto& code : codes_) {
+      if (code.first == table_store) {
+        return table_store->matchCode(tup, plan_->idx, code.second);
+      }
+    }
+    return false;
+  }
+  return table_store->matchVarString(tup, plan_->idx, &key_, val_->name);
+}
+
+bool EqualFilter::match(TupleIter* iter, FrozenCursor* cursor) {
+  if (raw()) {
+    return matchTuple(iter->store, iter->tup, cursor);
+  }
+  return FilterOperator::execEqualExpr(plan_->idx, val_, iter);
+}
 
+bool FilterOperator::execEqualExpr(size_t col_id, Expr* val,
+                                   TupleIter* iter) {
   Expr* col_val = iter->values[col_id];
   if (col_val->type != val->type) {
     return false;
@@ -1,126 +1,542 @@
 #pragma once
 
 #include "optimizer.h"
+#include "scheduler.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace bydb {
 
+/* Memory the hash tables of DISTINCT may take before they spill to disk. */
+#define DISTINCT_MEMORY_DEFAULT (64 * 1024 * 1024)
+/* A spilling DISTINCT splits its rows into partitions by these many bits of
+their hash, and splits spilled partitions again up to this depth. */
+#define DISTINCT_PARTITION_BITS 4
+#define DISTINCT_PARTITIONS (1 << DISTINCT_PARTITION_BITS)
+#define DISTINCT_MAX_DEPTH 8
+/* Bytes a row takes in a hash table besides its encoded values. */
+#define DISTINCT_ROW_OVERHEAD 64
+
+extern size_t g_distinct_memory;
+
+/* Allocated from the statement's arena, as are its values. */
 struct TupleIter {
-  TupleIter(Tuple* t) : tup(t) {}
-  ~TupleIter() {
-    for (auto expr : values) {
-      delete expr;
+  TupleIter(Tuple* t, TableStore* s, Arena* arena)
+      : tup(t), store(s), values(arena) {}
+
+  Tuple* tup;
+  TableStore* store;  // of the partition holding the tuple
+  ExprList values;
+};
+
+typedef std::vector<TupleIter*, ArenaAllocator<TupleIter*>> TupleIterList;
+
+/* Rows are hashed and compared on their values, NULL equals NULL as it does
+when set operations compare rows. */
+struct RowHash {
+  size_t operator()(const TupleIter* iter) const;
+};
+
+struct RowEqual {
+  bool operator()(const TupleIter* a, const TupleIter* b) const;
+};
+
+typedef std::unordered_map<TupleIter*, size_t, RowHash, RowEqual> RowCountMap;
+
+/* Rows kept outside of a statement's arena, by DISTINCT when it spills
+and by the result cache. */
+void EncodeRow(TupleIter* iter, std::string* key);
+TupleIter* DecodeRow(const std::string& key, Arena* arena);
+
+/* State shared by the operators of one execution of a plan. */
+struct ExecContext {
+  ExecContext(Arena* a, std::vector<Expr*>* p)
+      : arena(a), params(p), analyze(false), resultKey(nullptr) {}
+
+  /* Plans may come from the plan cache with '?' in place of the literals,
+  the values of this execution are looked up here. */
+  Expr* bind(Expr* expr) {
+    if (expr->type == kExprParameter) {
+      return (*params)[expr->ival];
     }
+    return expr;
   }
 
-  Tuple* tup;
-  std::vector<Expr*> values;
+  Arena* arena;
+  std::vector<Expr*>* params;
+  bool analyze;  // run by EXPLAIN ANALYZE, results are not printed
+  /* Set for plans run through the result cache, their select hands the
+  rows to the cache under this key. */
+  const std::string* resultKey;
 };
 
+/* Operators are created in the statement's arena and released with it. */
 class BaseOperator {
  public:
-  BaseOperator(Plan* plan, BaseOperator* next) : plan_(plan), next_(next) {}
-  virtual ~BaseOperator() { delete next_; }
+  BaseOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : plan_(plan), next_(next), ctx_(ctx) {}
+  virtual ~BaseOperator() {}
   virtual bool exec(TupleIter** iter = nullptr) = 0;
 
+  /* Tells the operator no more rows are read from it, it passes that on to
+  its inputs, which may have work under way. */
+  virtual void stop() {
+    if (next_ != nullptr) {
+      next_->stop();
+    }
+  }
+
+  /* Bytes the operator and its inputs allocated from arenas of their own,
+  which the statement's arena does not count. */
+  virtual size_t ownArenaBytes() {
+    return (next_ != nullptr) ? next_->ownArenaBytes() : 0;
+  }
+
   Plan* plan_;
   BaseOperator* next_;
+  ExecContext* ctx_;
 };
 
 class CreateOperator : public BaseOperator {
  public:
-  CreateOperator(Plan* plan, BaseOperator* next) : BaseOperator(plan, next) {}
+  CreateOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
   ~CreateOperator() {}
   bool exec(TupleIter** iter = nullptr) override;
 };
 
 class DropOperator : public BaseOperator {
  public:
-  DropOperator(Plan* plan, BaseOperator* next) : BaseOperator(plan, next) {}
+  DropOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
   ~DropOperator() {}
   bool exec(TupleIter** iter = nullptr) override;
 };
 
 class InsertOperator : public BaseOperator {
  public:
-  InsertOperator(Plan* plan, BaseOperator* next) : BaseOperator(plan, next) {}
+  InsertOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
   ~InsertOperator() {}
   bool exec(TupleIter** iter = nullptr) override;
 };
 
 class UpdateOperator : public BaseOperator {
  public:
-  UpdateOperator(Plan* plan, BaseOperator* next) : BaseOperator(plan, next) {}
+  UpdateOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
   ~UpdateOperator() {}
   bool exec(TupleIter** iter = nullptr) override;
 };
 
 class DeleteOperator : public BaseOperator {
  public:
-  DeleteOperator(Plan* plan, BaseOperator* next) : BaseOperator(plan, next) {}
+  DeleteOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
   ~DeleteOperator() {}
   bool exec(TupleIter** iter = nullptr) override;
 };
 
 class TrxOperator : public BaseOperator {
  public:
-  TrxOperator(Plan* plan, BaseOperator* next) : BaseOperator(plan, next) {}
+  TrxOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
   ~TrxOperator() {}
   bool exec(TupleIter** iter = nullptr) override;
 };
 
 class ShowOperator : public BaseOperator {
  public:
-  ShowOperator(Plan* plan, BaseOperator* next) : BaseOperator(plan, next) {}
+  ShowOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
   ~ShowOperator() {}
   bool exec(TupleIter** iter = nullptr) override;
 };
 
+class PrepareOperator : public BaseOperator {
+ public:
+  PrepareOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
+  ~PrepareOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+};
+
+class ExecuteOperator : public BaseOperator {
+ public:
+  ExecuteOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
+  ~ExecuteOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+};
+
+class AnalyzeOperator : public BaseOperator {
+ public:
+  AnalyzeOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
+  ~AnalyzeOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+};
+
+class TruncateOperator : public BaseOperator {
+ public:
+  TruncateOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
+  ~TruncateOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+};
+
+class PartitionOperator : public BaseOperator {
+ public:
+  PartitionOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
+  ~PartitionOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+};
+
+class ExplainOperator : public BaseOperator {
+ public:
+  ExplainOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
+  ~ExplainOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+};
+
+/* Wraps every operator of EXPLAIN ANALYZE and measures its calls. Times and
+memory include the operators below, like the rows they produce. Memory also
+counts the arenas operators allocate from besides the statement's one. */
+class ProfileOperator : public BaseOperator {
+ public:
+  ProfileOperator(BaseOperator* op, Plan* plan, std::string label,
+                  ExecContext* ctx)
+      : BaseOperator(plan, op->next_, ctx),
+        op_(op),
+        label_(label),
+        rows_(0),
+        batches_(0),
+        nanos_(0),
+        cycles_(0),
+        bytes_(0) {}
+  ~ProfileOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+  void stop() override { op_->stop(); }
+  size_t ownArenaBytes() override { return op_->ownArenaBytes(); }
+
+  void print(int depth);
+
+ private:
+  BaseOperator* op_;
+  std::string label_;
+  uint64_t rows_;
+  uint64_t batches_;  // calls of exec()
+  uint64_t nanos_;
+  uint64_t cycles_;
+  size_t bytes_;  // allocated from the statement's arena
+};
+
 class SelectOperator : public BaseOperator {
  public:
-  SelectOperator(Plan* plan, BaseOperator* next) : BaseOperator(plan, next) {}
+  SelectOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
   ~SelectOperator() {}
   bool exec(TupleIter** iter = nullptr) override;
 };
 
-class SeqScanOperator : public BaseOperator {
+class ProjectionOperator : public BaseOperator {
  public:
-  SeqScanOperator(Plan* plan, BaseOperator* next)
-      : BaseOperator(plan, next), finish(false), nextTuple_(nullptr) {}
-  ~SeqScanOperator() {
-    for (auto iter : tuples_) {
-      delete iter;
-    }
+  ProjectionOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx) {}
+  ~ProjectionOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+};
+
+/* Operators reading a second input, 'right_', besides 'next_'. */
+class BinaryOperator : public BaseOperator {
+ public:
+  BinaryOperator(Plan* plan, BaseOperator* next, BaseOperator* right,
+                 ExecContext* ctx)
+      : BaseOperator(plan, next, ctx), right_(right) {}
+  ~BinaryOperator() {}
+
+  void stop() override {
+    BaseOperator::stop();
+    right_->stop();
   }
+  size_t ownArenaBytes() override {
+    return BaseOperator::ownArenaBytes() + right_->ownArenaBytes();
+  }
+
+  BaseOperator* right() { return right_; }
+
+ protected:
+  BaseOperator* right_;
+};
+
+/* UNION ALL returns the rows of the left input, then those of the right
+one. UNION returns the rows it did not see yet, in the same order. INTERSECT
+and EXCEPT hash the right input first and stream the left one, ALL keeps as
+many copies of a row as the counts of both sides allow. */
+class SetOpOperator : public BinaryOperator {
+ public:
+  SetOpOperator(Plan* plan, BaseOperator* next, BaseOperator* right,
+                ExecContext* ctx)
+      : BinaryOperator(plan, next, right, ctx),
+        started_(false),
+        leftDone_(false) {}
+  ~SetOpOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+
+ private:
+  bool buildRight();
+  bool keep(TupleIter* iter);
+
+  bool started_;
+  bool leftDone_;     // union: reading the right input
+  RowCountMap rows_;  // rows of the right input, or rows returned
+};
+
+/* Runs the subquery of IN or EXISTS once, into a hash table of the values
+it returns, and streams the rows of 'next_' matching one of them. An anti
+join streams the rows matching none. Uncorrelated EXISTS reads a single row
+of the subquery, which decides for all rows. NOT IN follows SQL's NULLs: a
+NULL from the subquery leaves no row, and a NULL row matches only when the
+subquery is empty. */
+class SemiJoinOperator : public BinaryOperator {
+ public:
+  SemiJoinOperator(Plan* plan, BaseOperator* next, BaseOperator* right,
+                   ExecContext* ctx)
+      : BinaryOperator(plan, next, right, ctx),
+        started_(false),
+        empty_(true),
+        hasNull_(false),
+        probe_(nullptr) {}
+  ~SemiJoinOperator() {}
   bool exec(TupleIter** iter = nullptr) override;
 
  private:
-  bool finish;
+  bool build();
+
+  bool started_;
+  bool empty_;        // the subquery returned no rows
+  bool hasNull_;      // the subquery returned NULL
+  TupleIter* probe_;  // the value of the row looked up
+  std::unordered_set<TupleIter*, RowHash, RowEqual> keys_;
+};
+
+/* Skips the first OFFSET rows of its input and returns at most LIMIT of the
+next ones. Once it has them, the input is stopped, so scans below it do not
+read the rest of the table. */
+class LimitOperator : public BaseOperator {
+ public:
+  LimitOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx),
+        started_(false),
+        limit_(0),
+        offset_(0),
+        returned_(0) {}
+  ~LimitOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+
+ private:
+  bool started_;
+  uint64_t limit_;
+  uint64_t offset_;  // rows left to skip
+  uint64_t returned_;
+};
+
+/* Returns every row the first time it reads it, so a consumer can stop
+early. Rows are kept encoded in one hash table per partition of their hash.
+Once the tables outgrow g_distinct_memory, the largest partition is written
+to a temporary file, and so are the rows of it read later. Each spilled
+partition is deduplicated by a pass of its own after the input, splitting it
+on the next bits of the hash if it does not fit either. */
+class DistinctOperator : public BaseOperator {
+ public:
+  DistinctOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx), started_(false) {}
+  ~DistinctOperator();
+  bool exec(TupleIter** iter = nullptr) override;
+
+ private:
+  /* Rows of a spilled partition returned before it spilled, and the rows
+  read after it. */
+  struct Spill {
+    Spill() : returned(nullptr), pending(nullptr) {}
+    FILE* returned;
+    FILE* pending;
+  };
+
+  /* Deduplicates the input, or the rows of a partition spilled by the pass
+  before it. */
+  struct Pass {
+    Pass(int d) : depth(d), total(0), nextSpill(0), inputDone(false) {
+      for (auto& part_bytes : bytes) {
+        part_bytes = 0;
+      }
+    }
+    ~Pass();
+
+    int depth;
+    Spill input;  // files read by passes over spilled partitions
+    std::unordered_set<std::string> rows[DISTINCT_PARTITIONS];
+    size_t bytes[DISTINCT_PARTITIONS];
+    size_t total;
+    Spill spills[DISTINCT_PARTITIONS];
+    size_t nextSpill;  // next partition to look at once the input is done
+    bool inputDone;
+  };
+
+  bool readRow(Pass* pass, std::string* key, TupleIter** row, bool* returned);
+  bool spill(Pass* pass);
+  void nextPass(Pass* pass);
+
+  bool started_;
+  std::vector<Pass*> passes_;  // the last one is running
+};
+
+class SeqScanOperator : public BaseOperator {
+ public:
+  SeqScanOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx),
+        started_(false),
+        storeIdx_(0),
+        nextTuple_(nullptr) {}
+  ~SeqScanOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+
+ private:
+  bool started_;
+  std::vector<TableStore*> stores_;  // partitions left after pruning
+  size_t storeIdx_;
   Tuple* nextTuple_;
-  std::vector<TupleIter*> tuples_;
+  FrozenCursor cursor_;
+};
+
+/* An equality filter with its value bound. Integer, encoded CHAR and VARCHAR
+columns are matched on the stored tuple, so tuples can be skipped before
+being parsed: the value is looked up in the dictionary once, or turned into
+the length and prefix a VARCHAR is compared on first. Integers of frozen
+groups are compared without decompressing the group. */
+class EqualFilter {
+ public:
+  EqualFilter()
+      : plan_(nullptr),
+        val_(nullptr),
+        mode_(kMatchValue),
+        missing_(false) {}
+  void init(FilterPlan* plan, Expr* val);
+
+  /* True if matchTuple() can be called on unparsed tuples. */
+  bool raw() { return mode_ != kMatchValue; }
+  bool matchTuple(TableStore* table_store, Tuple* tup,
+                  FrozenCursor* cursor = nullptr);
+  bool match(TupleIter* iter, FrozenCursor* cursor = nullptr);
+
+ private:
+  enum MatchMode { kMatchValue, kMatchInt, kMatchChar, kMatchVarString };
+
+  FilterPlan* plan_;
+  Expr* val_;
+  MatchMode mode_;
+  bool missing_;  // no stored value can be equal
+  /* Every partition has its own dictionary, if any, the value's code in
+  those holding it. */
+  std::vector<std::pair<TableStore*, uint32_t>> codes_;
+  VarString key_;
+};
+
+/* Splits the table into morsels along its tuple groups, which are parsed and
+filtered as tasks on the scheduler. The results are returned in morsel
+order, which is the slot order of the groups and not the order of
+SeqScanOperator. The scan strategy is costed again when the operator tree is
+built, so cached plans follow the table as it grows. */
+class ParallelSeqScanOperator : public BaseOperator {
+ public:
+  ParallelSeqScanOperator(Plan* plan, FilterPlan* filter, bool pipelined,
+                          ExecContext* ctx)
+      : BaseOperator(plan, nullptr, ctx),
+        filter_(filter),
+        pipelined_(pipelined),
+        started_(false),
+        stopped_(false),
+        submitted_(0),
+        morselIdx_(0),
+        pos_(0) {}
+  ~ParallelSeqScanOperator() {}
+  bool exec(TupleIter** iter = nullptr) override;
+  void stop() override;
+  size_t ownArenaBytes() override;
+
+ private:
+  void scanMorsels();
+  void submitMorsels();
+  void scanMorsel(size_t idx);
+
+  FilterPlan* filter_;  // pushed down into the workers, may be null
+  EqualFilter equal_;
+  /* Rows of a morsel are returned as soon as it is scanned, while workers
+  go on with the next ones, at most MORSEL_WINDOW per worker ahead.
+  Statements changing the table wait for every morsel before they get the
+  first row. */
+  bool pipelined_;
+  bool started_;
+  std::atomic<bool> stopped_;  // morsels not started yet are skipped
+  TaskGroup group_;
+  std::vector<std::pair<TableStore*, SlotRange>> morsels_;
+  std::vector<std::vector<TupleIter*>> results_;
+  std::unique_ptr<std::atomic<bool>[]> done_;  // one per morsel
+  std::vector<Arena*> arenas_;  // one per morsel, tasks do not share arenas
+  size_t submitted_;  // morsels queued so far
+  size_t morselIdx_;
+  size_t pos_;
 };
 
 class FilterOperator : public BaseOperator {
  public:
-  FilterOperator(Plan* plan, BaseOperator* next) : BaseOperator(plan, next) {}
+  FilterOperator(Plan* plan, BaseOperator* next, ExecContext* ctx)
+      : BaseOperator(plan, next, ctx), started_(false) {}
   ~FilterOperator() {}
   bool exec(TupleIter** iter = nullptr) override;
 
+  static bool execEqualExpr(size_t col_id, Expr* val, TupleIter* iter);
+
  private:
-  bool execEqualExpr(TupleIter* iter);
+  bool started_;
+  EqualFilter equal_;
+  FrozenCursor cursor_;
 };
 
 class Executor {
  public:
-  Executor(Plan* plan) : planTree_(plan) {}
+  Executor(Plan* plan, Arena* arena, std::vector<Expr*>* params = nullptr)
+      : planTree_(plan),
+        opTree_(nullptr),
+        ctx_(arena, params),
+        profile_(false),
+        pipelined_(false) {}
   ~Executor() {}
   void init();
   bool exec();
+  void cacheResult(const std::string* key) { ctx_.resultKey = key; }
+
+  static bool useParallelScan(Plan* scan, ExecContext* ctx,
+                              double limit = -1);
 
  private:
-  BaseOperator* generateOperator(Plan* Plan);
+  BaseOperator* generateOperator(Plan* Plan, double limit = -1);
+
+  BaseOperator* profile(BaseOperator* op, Plan* plan, std::string label);
 
   Plan* planTree_;
   BaseOperator* opTree_;
+  ExecContext ctx_;
+  bool profile_;    // wrap the operators in ProfileOperator
+  bool pipelined_;  // parallel scans hand out rows while they run
 };
 
 }  // namespace bydb
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "extent.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdint>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace bydb {
+
+#define PAGE_SIZE_BYTES 4096
+#define MPOL_PREFERRED_MODE 1
+
+static bool s_numa_local = false;
+
+void SetNumaLocal(bool numa_local) { s_numa_local = numa_local; }
+
+size_t ExtentSize(size_t size) {
+  size_t align = (size >= HUGE_PAGE_SIZE) ? HUGE_PAGE_SIZE : PAGE_SIZE_BYTES;
+  return (size + align - 1) / align * align;
+}
+
+/* Prefers the node of the CPU the caller runs on, the kernel falls back to
+other nodes when it is full. */
+static void BindLocal(void* ptr, size_t size) {
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0 || node >= 64) {
+    return;
+  }
+  unsigned long mask = 1UL << node;
+  syscall(SYS_mbind, ptr, size, MPOL_PREFERRED_MODE, &mask, 64, 0);
+#endif
+}
+
+void* AllocExtent(size_t size) {
+  size = ExtentSize(size);
+  if (size < HUGE_PAGE_SIZE) {
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+      return nullptr;
+    }
+    if (s_numa_local) {
+      BindLocal(ptr, size);
+    }
+    return ptr;
+  }
+
+  /* Map one huge page more than needed and unmap what lies around the
+  aligned part. */
+  size_t map_size = size + HUGE_PAGE_SIZE;
+  void* map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) {
+    return nullptr;
+  }
+
+  uintptr_t start = reinterpret_cast<uintptr_t>(map);
+  uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE *
+                      HUGE_PAGE_SIZE;
+  if (aligned > start) {
+    munmap(map, aligned - start);
+  }
+  size_t tail = start + map_size - (aligned + size);
+  if (tail > 0) {
+    munmap(reinterpret_cast<void*>(aligned + size), tail);
+  }
+
+  void* ptr = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+  madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+  if (s_numa_local) {
+    BindLocal(ptr, size);
+  }
+  return ptr;
+}
+
+void FreeExtent(void* ptr, size_t size) { munmap(ptr, ExtentSize(size)); }
+
+}  // namespace bydb
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace bydb {
+
+#define EXTENT_MIN_SIZE (64 * 1024)
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/* Memory for tuple groups, mapped from the OS rather than taken from the
+heap, so freeing an extent gives it back at once. Sizes are rounded up to
+whole pages. Extents of a huge page or more are aligned to it and advised to
+use transparent huge pages. Pages are only backed once they are touched. */
+size_t ExtentSize(size_t size);
+void* AllocExtent(size_t size);
+void FreeExtent(void* ptr, size_t size);
+
+/* Places new extents on the NUMA node of the thread allocating them, instead
+of following the process' memory policy. */
+void SetNumaLocal(bool numa_local);
+
+}  // namespace bydb
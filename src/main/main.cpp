@@ -1,41 +1,44 @@
+#include "compactor.h"
+#include "engine.h"
 #include "executor.h"
-#include "optimizer.h"
-#include "parser.h"
+#include "extent.h"
+#include "result_cache.h"
+#include "scheduler.h"
 
 #include <stdlib.h>
 #include <iostream>
 #include <string>
 
 using namespace bydb;
-using namespace hsql;
 
-static bool ExecStmt(std::string stmt) {
-  Parser parser;
-  if (parser.parseStatement(stmt)) {
-    return true;
-  }
-
-  SQLParserResult* result = parser.getResult();
-  Optimizer optimizer;
-
-  for (size_t i = 0; i < result->size(); ++i) {
-    const SQLStatement* stmt = result->getStatement(i);
-    Plan* plan = optimizer.createPlanTree(stmt);
-    if (plan == nullptr) {
-      return true;
-    }
-
-    Executor executor(plan);
-    executor.init();
-    if (executor.exec()) {
-      return true;
+int main(int argc, char* argv[]) {
+  size_t thread_num = 0;
+  bool pin_threads = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      thread_num = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--pin-threads") {
+      pin_threads = true;
+    } else if (arg == "--compact-interval" && i + 1 < argc) {
+      g_compactor.setInterval(strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--numa-local") {
+      SetNumaLocal(true);
+    } else if (arg == "--distinct-memory" && i + 1 < argc) {
+      g_distinct_memory = strtoul(argv[++i], nullptr, 10) * 1024;
+    } else if (arg == "--result-cache" && i + 1 < argc) {
+      g_result_cache.setCapacity(strtoul(argv[++i], nullptr, 10) * 1024);
+    } else {
+      std::cout << "Usage: " << argv[0]
+                << " [--threads <num>] [--pin-threads]"
+                   " [--compact-interval <ms>] [--numa-local]"
+                   " [--distinct-memory <KB>] [--result-cache <KB>]"
+                << std::endl;
+      return 1;
     }
   }
+  g_scheduler.start(thread_num, pin_threads);
 
-  return false;
-}
-
-int main(int argc, char* argv[]) {
   std::cout << "# Welcome to ByteYoung DB!!!" << std::endl;
   std::cout << "# Input your query in one line." << std::endl;
   std::cout << "# Enter 'exit' or 'q' to quit this program." << std::endl;
@@ -59,6 +62,11 @@ int main(int argc, char* argv[]) {
     std::cout << std::endl;
   }
 
+  g_scheduler.stop();
+  if (g_result_cache.enabled()) {
+    std::cout << "# Result cache: " << g_result_cache.hits() << " hits, "
+              << g_result_cache.misses() << " misses." << std::endl;
+  }
   std::cout << "# Farewell~~~ " << std::endl;
   return 0;
 }
\ No newline at end of file
@@ -9,8 +9,8 @@ namespace bydb {
 
 MetaData g_meta_data;
 
-Table::Table(char* schema, char* name,
-             std::vector<ColumnDefinition*>* columns) {
+Table::Table(char* schema, char* name, std::vector<ColumnDefinition*>* columns,
+             const PartitionSpec* spec) {
   schema_ = strdup(schema);
   name_ = strdup(name);
   for (auto col_old : *columns) {
@@ -20,42 +20,171 @@ Table::Table(char* schema, char* name,
     ColumnDefinition* col = new ColumnDefinition(
         strdup(col_old->name), col_old->type, column_constraints);
     col->nullable = col_old->nullable;
+    columnIds_.emplace(col->name, columns_.size());
     columns_.push_back(col);
   }
 
-  tableStore_ = new TableStore(&columns_);
+  partType_ = kPartitionNone;
+  partColId_ = -1;
+  partitions_ = new std::vector<Partition*>();
+  if (spec == nullptr || spec->type == kPartitionNone) {
+    partitions_.load()->push_back(new Partition("", 0, &columns_));
+  } else if (spec->type == kPartitionRange) {
+    for (size_t i = 0; i < spec->names.size(); i++) {
+      partitions_.load()->push_back(
+          new Partition(spec->names[i], spec->bounds[i], &columns_));
+    }
+  } else {
+    for (size_t i = 0; i < spec->hashNum; i++) {
+      partitions_.load()->push_back(
+          new Partition("p" + std::to_string(i), 0, &columns_));
+    }
+  }
+  if (spec != nullptr && spec->type != kPartitionNone) {
+    partType_ = spec->type;
+    partColId_ = getColumnId(spec->column.c_str());
+  }
+  indexes_ = new std::vector<Index*>();
+  stats_ = nullptr;
 }
 
 Table::~Table() {
   free(schema_);
   free(name_);
-  delete tableStore_;
+  for (auto partition : *partitions_.load()) {
+    delete partition;
+  }
+  delete partitions_.load();
+  delete stats_.load();
+  for (auto index : *indexes_.load()) {
+    delete index;
+  }
+  delete indexes_.load();
   for (auto col : columns_) {
     delete col;
   }
 }
 
 ColumnDefinition* Table::getColumn(char* name) {
-  if (name == nullptr || strlen(name) == 0) {
-    return nullptr;
+  int col_id = getColumnId(name);
+  return (col_id < 0) ? nullptr : columns_[col_id];
+}
+
+int Table::getColumnId(const char* name) {
+  if (name == nullptr) {
+    return -1;
   }
 
-  for (auto col : columns_) {
-    if (strcmp(name, col->name) == 0) {
-      return col;
+  auto iter = columnIds_.find(name);
+  return (iter == columnIds_.end()) ? -1 : static_cast<int>(iter->second);
+}
+
+TableStore* Partition::truncate() {
+  TableStore* table_store = tableStore_;
+  tableStore_ = new TableStore(columns_);
+  return table_store;
+}
+
+void Partition::restoreStore(TableStore* table_store) {
+  delete tableStore_;
+  tableStore_ = table_store;
+}
+
+/* NULL goes to the first partition. Integers are hashed as they are. */
+int Table::partitionOf(const Expr* val) {
+  const std::vector<Partition*>* parts = partitions();
+  if (parts->empty()) {
+    return -1;
+  }
+  if (partType_ == kPartitionNone || val->type == kExprLiteralNull) {
+    return 0;
+  }
+
+  if (partType_ == kPartitionRange) {
+    if (val->type != kExprLiteralInt) {
+      return -1;
     }
+    for (size_t i = 0; i < parts->size(); i++) {
+      int64_t bound = (*parts)[i]->bound();
+      if (val->ival < bound || bound == PARTITION_MAXVALUE) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  uint64_t hash = 0;
+  if (val->type == kExprLiteralInt) {
+    hash = static_cast<uint64_t>(val->ival);
+  } else if (val->type == kExprLiteralString) {
+    hash = BKDRHash(val->name, strlen(val->name));
+  } else {
+    return -1;
   }
+  return hash % parts->size();
+}
 
+Partition* Table::getPartition(const char* name) {
+  for (auto partition : *partitions()) {
+    if (partition->name() == name) {
+      return partition;
+    }
+  }
   return nullptr;
 }
 
+/* Writers are serialized by MetaData. */
+void Table::addPartition(Partition* partition) {
+  std::vector<Partition*>* old_parts = partitions_.load();
+  std::vector<Partition*>* new_parts =
+      new std::vector<Partition*>(*old_parts);
+  new_parts->push_back(partition);
+  partitions_.store(new_parts);
+  g_epoch.retire(old_parts);
+}
+
+/* The rows go with the partition's store, freed once no reader is left. */
+bool Table::dropPartition(const char* name) {
+  Partition* partition = getPartition(name);
+  if (partition == nullptr) {
+    return true;
+  }
+
+  std::vector<Partition*>* old_parts = partitions_.load();
+  std::vector<Partition*>* new_parts = new std::vector<Partition*>();
+  for (auto part : *old_parts) {
+    if (part != partition) {
+      new_parts->push_back(part);
+    }
+  }
+  partitions_.store(new_parts);
+  g_epoch.retire(old_parts);
+  g_epoch.retire(partition);
+  return false;
+}
+
+size_t Table::tupleCount() {
+  size_t count = 0;
+  for (auto partition : *partitions()) {
+    count += partition->getTableStore()->tupleCount();
+  }
+  return count;
+}
+
+void Table::setStats(TableStats* stats) {
+  TableStats* old_stats = stats_.exchange(stats);
+  if (old_stats != nullptr) {
+    g_epoch.retire(old_stats);
+  }
+}
+
 Index* Table::getIndex(char* name) {
   if (name == nullptr || strlen(name) == 0) {
     return nullptr;
   }
 
-  for (auto index : indexes_) {
-    if (strcmp(name, index->name)) {
+  for (auto index : *indexes()) {
+    if (strcmp(name, index->name) == 0) {
       return index;
     }
   }
@@ -63,18 +192,97 @@ Index* Table::getIndex(char* name) {
   return nullptr;
 }
 
+/* Writers are serialized by MetaData. */
+void Table::addIndex(Index* index) {
+  std::vector<Index*>* old_indexes = indexes_.load();
+  std::vector<Index*>* new_indexes = new std::vector<Index*>(*old_indexes);
+  new_indexes->push_back(index);
+  indexes_.store(new_indexes);
+  g_epoch.retire(old_indexes);
+}
+
+bool Table::dropIndex(char* name) {
+  Index* index = getIndex(name);
+  if (index == nullptr) {
+    return true;
+  }
+
+  std::vector<Index*>* old_indexes = indexes_.load();
+  std::vector<Index*>* new_indexes = new std::vector<Index*>();
+  for (auto idx : *old_indexes) {
+    if (idx != index) {
+      new_indexes->push_back(idx);
+    }
+  }
+  indexes_.store(new_indexes);
+  g_epoch.retire(old_indexes);
+  g_epoch.retire(index);
+  return false;
+}
+
+MetaData::MetaData() { catalog_ = new Catalog(); }
+
+/* No reader is left at exit. */
+MetaData::~MetaData() {
+  Catalog* catalog = catalog_.load();
+  for (auto iter : catalog->tables) {
+    delete iter.second;
+  }
+  delete catalog;
+}
+
+/* Must be called with ddlMutex_ held. */
+void MetaData::publish(Catalog* catalog) {
+  Catalog* old_catalog = catalog_.load();
+  catalog->version = old_catalog->version + 1;
+  catalog_.store(catalog);
+  g_epoch.retire(old_catalog);
+}
+
 bool MetaData::insertTable(Table* table) {
+  std::lock_guard<std::mutex> lock(ddlMutex_);
   if (getTable(table->schema(), table->name()) != nullptr) {
     return true;
-  } else {
-    TableName table_name;
-    SetTableName(table_name, table->schema(), table->name());
-    table_map_.emplace(table_name, table);
-    return false;
   }
+
+  Catalog* catalog = new Catalog(*catalog_.load());
+  TableName table_name;
+  SetTableName(table_name, table->schema(), table->name());
+  catalog->tables.emplace(table_name, table);
+  publish(catalog);
+  return false;
+}
+
+void MetaData::insertIndex(Table* table, Index* index) {
+  std::lock_guard<std::mutex> lock(ddlMutex_);
+  table->addIndex(index);
+  publish(new Catalog(*catalog_.load()));
+}
+
+void MetaData::addPartition(Table* table, Partition* partition) {
+  std::lock_guard<std::mutex> lock(ddlMutex_);
+  table->addPartition(partition);
+  publish(new Catalog(*catalog_.load()));
+}
+
+bool MetaData::dropPartition(Table* table, const char* name) {
+  std::lock_guard<std::mutex> lock(ddlMutex_);
+  if (table->dropPartition(name)) {
+    return true;
+  }
+  publish(new Catalog(*catalog_.load()));
+  return false;
+}
+
+/* New statistics may change plans, so they bump the version as DDL does. */
+void MetaData::updateStats(Table* table, TableStats* stats) {
+  std::lock_guard<std::mutex> lock(ddlMutex_);
+  table->setStats(stats);
+  publish(new Catalog(*catalog_.load()));
 }
 
 bool MetaData::dropIndex(char* schema, char* name, char* indexName) {
+  std::lock_guard<std::mutex> lock(ddlMutex_);
   Table* table = getTable(schema, name);
   if (table == nullptr) {
     std::cout << "[BYDB-Error]  Table " << TableNameToString(schema, name)
@@ -82,48 +290,57 @@ bool MetaData::dropIndex(char* schema, char* name, char* indexName) {
     return true;
   }
 
-  bool ret = true;
-  std::vector<Index*>& indexes = *table->indexes();
-  for (size_t i = 0; i < indexes.size(); i++) {
-    Index* index = indexes[i];
-    if (strcmp(index->name, indexName) == 0) {
-      indexes.erase(indexes.begin() + i);
-      ret = false;
-    }
+  if (table->dropIndex(indexName)) {
+    return true;
   }
 
-  return ret;
+  publish(new Catalog(*catalog_.load()));
+  return false;
 }
 
 bool MetaData::dropTable(char* schema, char* name) {
+  std::lock_guard<std::mutex> lock(ddlMutex_);
   Table* table = getTable(schema, name);
   if (table == nullptr) {
     return true;
   }
 
+  Catalog* catalog = new Catalog(*catalog_.load());
   TableName table_name;
   SetTableName(table_name, schema, name);
-  table_map_.erase(table_name);
-  delete table;
+  catalog->tables.erase(table_name);
+  publish(catalog);
+  g_epoch.retire(table);
   return false;
 }
 
 bool MetaData::dropSchema(char* schema) {
-  auto iter = table_map_.begin();
-  bool ret = true;
-  while (iter != table_map_.end()) {
+  std::lock_guard<std::mutex> lock(ddlMutex_);
+  Catalog* catalog = new Catalog(*catalog_.load());
+  std::vector<Table*> dropped;
+  auto iter = catalog->tables.begin();
+  while (iter != catalog->tables.end()) {
     Table* table = iter->second;
     if (strcmp(table->schema(), schema) == 0) {
       std::cout << "[BYDB-Info]  Drop table " << table->name() << " in schema "
                 << schema << std::endl;
-      iter = table_map_.erase(iter);
-      delete table;
-      ret = false;
+      iter = catalog->tables.erase(iter);
+      dropped.push_back(table);
     } else {
       iter++;
     }
   }
-  return ret;
+
+  if (dropped.empty()) {
+    delete catalog;
+    return true;
+  }
+
+  publish(catalog);
+  for (auto table : dropped) {
+    g_epoch.retire(table);
+  }
+  return false;
 }
 
 void MetaData::getAllTables(std::vector<Table*>* tables) {
@@ -131,13 +348,13 @@ void MetaData::getAllTables(std::vector<Table*>* tables) {
     return;
   }
 
-  for (auto iter : table_map_) {
+  for (auto iter : catalog_.load()->tables) {
     tables->push_back(iter.second);
   }
 }
 
 bool MetaData::findSchema(char* schema) {
-  for (auto iter : table_map_) {
+  for (auto iter : catalog_.load()->tables) {
     Table* table = iter.second;
     if (strcmp(table->schema(), schema) == 0) {
       return true;
@@ -158,8 +375,9 @@ Table* MetaData::getTable(char* schema, char* name) {
   TableName table_name;
   SetTableName(table_name, schema, name);
 
-  auto iter = table_map_.find(table_name);
-  if (iter == table_map_.end()) {
+  Catalog* catalog = catalog_.load();
+  auto iter = catalog->tables.find(table_name);
+  if (iter == catalog->tables.end()) {
     return nullptr;
   } else {
     return iter->second;
@@ -174,13 +392,7 @@ Index* MetaData::getIndex(char* schema, char* name, char* index_name) {
     return nullptr;
   }
 
-  for (auto index : *table->indexes()) {
-    if (strcmp(index->name, index_name) == 0) {
-      return index;
-    }
-  }
-
-  return nullptr;
+  return table->getIndex(index_name);
 }
 
 }  // namespace bydb
\ No newline at end of file
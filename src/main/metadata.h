@@ -1,10 +1,15 @@
 #pragma once
 
+#include "epoch.h"
 #include "sql/CreateStatement.h"
 #include "sql/Table.h"
+#include "stats.h"
 #include "storage.h"
 
 #include <string.h>
+#include <atomic>
+#include <mutex>
+#include <string>
 #include <unordered_map>
 
 using namespace hsql;
@@ -45,34 +50,116 @@ struct Index {
   std::vector<ColumnDefinition*> columns;
 };
 
+enum PartitionType { kPartitionNone, kPartitionRange, kPartitionHash };
+
+/* PARTITION BY of CREATE TABLE. Range partitions hold the values below
+their bound and not below the bound of the previous one, the last bound may
+be MAXVALUE. Hash partitions hold the values whose hash modulo the number of
+partitions is their position. */
+struct PartitionSpec {
+  PartitionSpec() : type(kPartitionNone), hashNum(0) {}
+  PartitionType type;
+  std::string column;
+  std::vector<std::string> names;  // range
+  std::vector<int64_t> bounds;     // range, ascending
+  size_t hashNum;                  // hash
+};
+
+#define PARTITION_MAXVALUE INT64_MAX
+#define PARTITION_MAX_NUM 1024
+
+/* Every table has at least one partition, each with its own store. */
+class Partition {
+ public:
+  Partition(const std::string& name, int64_t bound,
+            std::vector<ColumnDefinition*>* columns)
+      : name_(name),
+        bound_(bound),
+        columns_(columns),
+        tableStore_(new TableStore(columns)) {}
+  ~Partition() { delete tableStore_; }
+
+  const std::string& name() { return name_; }
+  int64_t bound() { return bound_; }
+  TableStore* getTableStore() { return tableStore_; };
+  /* Gives the partition a new, empty store and returns the old one, which
+  the caller frees or hands back with restoreStore(). */
+  TableStore* truncate();
+  void restoreStore(TableStore* table_store);
+
+ private:
+  std::string name_;
+  int64_t bound_;  // range only
+  std::vector<ColumnDefinition*>* columns_;
+  TableStore* tableStore_;
+};
+
+/* Indexes, partitions and statistics are replaced rather than changed in
+place, the old ones are retired to g_epoch, so pinned readers never need a
+lock. */
 class Table {
  public:
-  Table(char* schema, char* name, std::vector<ColumnDefinition*>* columns);
+  Table(char* schema, char* name, std::vector<ColumnDefinition*>* columns,
+        const PartitionSpec* spec = nullptr);
   ~Table();
 
   ColumnDefinition* getColumn(char* name);
+  /* Ordinal of the column, -1 if the table has no such column. */
+  int getColumnId(const char* name);
   Index* getIndex(char* name);
   char* schema() { return schema_; };
   char* name() { return name_; };
   std::vector<ColumnDefinition*>* columns() { return &columns_; };
-  std::vector<Index*>* indexes() { return &indexes_; };
-  void addIndex(Index* index) { indexes_.push_back(index); };
-  TableStore* getTableStore() { return tableStore_; };
+  const std::vector<Index*>* indexes() { return indexes_.load(); };
+  void addIndex(Index* index);
+  bool dropIndex(char* name);
+  const std::vector<Partition*>* partitions() { return partitions_.load(); }
+  PartitionType partitionType() { return partType_; }
+  /* Column the table is partitioned by, -1 if it is not. */
+  int partitionColumn() { return partColId_; }
+  /* Position of the partition a row whose partition column is 'val' belongs
+  to, -1 if there is none. Tables that are not partitioned have one. */
+  int partitionOf(const Expr* val);
+  Partition* getPartition(const char* name);
+  void addPartition(Partition* partition);
+  bool dropPartition(const char* name);
+  size_t tupleCount();
+  TableStats* stats() { return stats_.load(); };
+  void setStats(TableStats* stats);
 
  private:
   char* schema_;
   char* name_;
   std::vector<ColumnDefinition*> columns_;
-  std::vector<Index*> indexes_;
-  TableStore* tableStore_;
+  std::unordered_map<std::string, size_t> columnIds_;  // name -> ordinal
+  std::atomic<std::vector<Index*>*> indexes_;
+  PartitionType partType_;
+  int partColId_;
+  std::atomic<std::vector<Partition*>*> partitions_;
+  std::atomic<TableStats*> stats_;  // collected by ANALYZE, null before
 };
 
+/* One immutable version of the catalog. */
+struct Catalog {
+  Catalog() : version(0) {}
+  std::unordered_map<TableName, Table*> tables;
+  uint64_t version;
+};
+
+/* The catalog is read without locks: readers pin g_epoch (see EpochGuard)
+for as long as they use what they look up. DDL copies the current Catalog,
+changes the copy and publishes it with one atomic store, the old version and
+dropped tables are freed once no pinned reader can still see them. */
 class MetaData {
  public:
-  MetaData(){};
-  ~MetaData(){};
+  MetaData();
+  ~MetaData();
 
   bool insertTable(Table* table);
+  void insertIndex(Table* table, Index* index);
+  void addPartition(Table* table, Partition* partition);
+  bool dropPartition(Table* table, const char* name);
+  void updateStats(Table* table, TableStats* stats);
   bool dropIndex(char* schema, char* name, char* indexName);
   bool dropTable(char* schema, char* name);
   bool dropSchema(char* schema);
@@ -82,8 +169,14 @@ class MetaData {
   Table* getTable(char* schema, char* name);
   Index* getIndex(char* schema, char* name, char* index_name);
 
+  /* Bumped by every DDL, plans built under an older version are stale. */
+  uint64_t version() { return catalog_.load()->version; }
+
  private:
-  std::unordered_map<TableName, Table*> table_map_;
+  void publish(Catalog* catalog);
+
+  std::atomic<Catalog*> catalog_;
+  std::mutex ddlMutex_;  // serializes writers only
 };
 
 extern MetaData g_meta_data;
@@ -1,30 +1,37 @@
 #include "optimizer.h"
 #include "util.h"
 
+#include <algorithm>
 #include <iostream>
 
 using namespace hsql;
 
 namespace bydb {
 
-Plan* Optimizer::createPlanTree(const SQLStatement* stmt) {
+Plan* Optimizer::createPlanTree(const BoundStatement* bound) {
+  const SQLStatement* stmt = bound->stmt;
   switch (stmt->type()) {
     case kStmtSelect:
-      return createSelectPlanTree(static_cast<const SelectStatement*>(stmt));
+      return createSelectPlanTree(bound);
     case kStmtInsert:
-      return createInsertPlanTree(static_cast<const InsertStatement*>(stmt));
+      return createInsertPlanTree(bound);
     case kStmtUpdate:
-      return createUpdatePlanTree(static_cast<const UpdateStatement*>(stmt));
+      return createUpdatePlanTree(bound);
     case kStmtDelete:
-      return createDeletePlanTree(static_cast<const DeleteStatement*>(stmt));
+      return createDeletePlanTree(bound);
     case kStmtCreate:
-      return createCreatePlanTree(static_cast<const CreateStatement*>(stmt));
+      return createCreatePlanTree(static_cast<const CreateStatement*>(stmt),
+                                  &bound->partition);
     case kStmtDrop:
       return createDropPlanTree(static_cast<const DropStatement*>(stmt));
     case kStmtTransaction:
       return createTrxPlanTree(static_cast<const TransactionStatement*>(stmt));
     case kStmtShow:
       return createShowPlanTree(static_cast<const ShowStatement*>(stmt));
+    case kStmtPrepare:
+      return createPreparePlanTree(static_cast<const PrepareStatement*>(stmt));
+    case kStmtExecute:
+      return createExecutePlanTree(static_cast<const ExecuteStatement*>(stmt));
     default:
       std::cout << "[BYDB-Error]  Statement type "
                 << StmtTypeToString(stmt->type()) << " is not supported now."
@@ -33,8 +40,46 @@ Plan* Optimizer::createPlanTree(const SQLStatement* stmt) {
   return nullptr;
 }
 
-Plan* Optimizer::createCreatePlanTree(const CreateStatement* stmt) {
-  CreatePlan* plan = new CreatePlan(stmt->type);
+Plan* Optimizer::createExtPlanTree(const ExtStatement* stmt) {
+  switch (stmt->type) {
+    case kExtStmtAnalyze: {
+      AnalyzePlan* plan = arena_->create<AnalyzePlan>();
+      plan->table = g_meta_data.getTable(stmt->schema, stmt->name);
+      return plan;
+    }
+    case kExtStmtTruncate: {
+      TruncatePlan* plan = arena_->create<TruncatePlan>();
+      plan->table = g_meta_data.getTable(stmt->schema, stmt->name);
+      return plan;
+    }
+    case kExtStmtAddPartition:
+    case kExtStmtDropPartition: {
+      PartitionPlan* plan = arena_->create<PartitionPlan>();
+      plan->table = g_meta_data.getTable(stmt->schema, stmt->name);
+      plan->drop = (stmt->type == kExtStmtDropPartition);
+      plan->name = stmt->partition;
+      plan->bound = stmt->bound;
+      return plan;
+    }
+    case kExtStmtExplain: {
+      ExplainPlan* plan = arena_->create<ExplainPlan>();
+      plan->analyze = stmt->analyze;
+      plan->plan = createPlanTree(stmt->stmt);
+      if (plan->plan == nullptr) {
+        return nullptr;
+      }
+      return plan;
+    }
+    default:
+      break;
+  }
+  return nullptr;
+}
+
+Plan* Optimizer::createCreatePlanTree(const CreateStatement* stmt,
+                                      const PartitionSpec* partition) {
+  CreatePlan* plan = arena_->create<CreatePlan>(stmt->type);
+  plan->partition = partition;
   plan->ifNotExists = stmt->ifNotExists;
   plan->type = stmt->type;
   plan->schema = stmt->schema;
@@ -46,19 +91,16 @@ Plan* Optimizer::createCreatePlanTree(const CreateStatement* stmt) {
   if (plan->type == kCreateIndex) {
     Table* table = g_meta_data.getTable(plan->schema, plan->tableName);
     if (table == nullptr) {
-      delete plan;
       return nullptr;
     }
 
     if (stmt->indexColumns != nullptr) {
-      plan->indexColumns = new std::vector<ColumnDefinition*>;
+      plan->indexColumns = arena_->create<std::vector<ColumnDefinition*>>();
     }
 
     for (auto col_name : *stmt->indexColumns) {
       ColumnDefinition* col_def = table->getColumn(col_name);
       if (col_def == nullptr) {
-        delete plan->indexColumns;
-        delete plan;
         return nullptr;
       }
       plan->indexColumns->push_back(col_def);
@@ -69,7 +111,7 @@ Plan* Optimizer::createCreatePlanTree(const CreateStatement* stmt) {
 }
 
 Plan* Optimizer::createDropPlanTree(const DropStatement* stmt) {
-  DropPlan* plan = new DropPlan();
+  DropPlan* plan = arena_->create<DropPlan>();
   plan->type = stmt->type;
   plan->ifExists = stmt->ifExists;
   plan->schema = stmt->schema;
@@ -79,148 +121,316 @@ Plan* Optimizer::createDropPlanTree(const DropStatement* stmt) {
   return plan;
 }
 
-Plan* Optimizer::createInsertPlanTree(const InsertStatement* stmt) {
-  InsertPlan* plan = new InsertPlan();
+Plan* Optimizer::createInsertPlanTree(const BoundStatement* bound) {
+  const InsertStatement* stmt =
+      static_cast<const InsertStatement*>(bound->stmt);
+  InsertPlan* plan = arena_->create<InsertPlan>();
   plan->type = stmt->type;
-  plan->table = g_meta_data.getTable(stmt->schema, stmt->tableName);
-  plan->values = stmt->values;
+  plan->table = bound->table;
+
+  /* Columns which were not given a value get NULL. */
+  for (auto value : bound->values) {
+    if (value == nullptr) {
+      value = arena_->alloc<Expr>(kExprLiteralNull);
+    }
+    plan->values.push_back(value);
+  }
 
   return plan;
 }
 
-Plan* Optimizer::createUpdatePlanTree(const UpdateStatement* stmt) {
-  Table* table = g_meta_data.getTable(stmt->table->schema, stmt->table->name);
+Plan* Optimizer::createUpdatePlanTree(const BoundStatement* bound) {
   Plan* plan;
 
-  ScanPlan* scan = new ScanPlan();
-  scan->type = kSeqScan;
-  scan->table = table;
-  plan = scan;
+  plan = createScanPlan(bound->table);
 
-  if (stmt->where != nullptr) {
-    Plan* filter = createFilterPlan(table->columns(), stmt->where);
-    filter->next = plan;
-    plan = filter;
+  if (bound->filterVal != nullptr) {
+    plan = createFilterPlan(bound, plan);
+  }
+  if (bound->subquery != nullptr) {
+    plan = createSemiJoinPlan(bound, plan);
   }
 
-  UpdatePlan* update = new UpdatePlan();
-  update->table = table;
+  UpdatePlan* update = arena_->create<UpdatePlan>();
+  update->table = bound->table;
   update->next = plan;
-
-  for (auto upd : *stmt->updates) {
-    size_t idx = 0;
-    update->values.push_back(upd->value);
-    for (auto col : *table->columns()) {
-      if (strcmp(upd->column, col->name) == 0) {
-        update->idxs.push_back(idx);
-        break;
-      }
-      idx++;
-    }
-  }
+  update->rows = plan->rows;
+  update->cost = plan->cost;
+  update->values = bound->values;
+  update->idxs = bound->colIds;
 
   return update;
 }
 
-Plan* Optimizer::createDeletePlanTree(const DeleteStatement* stmt) {
-  Table* table = g_meta_data.getTable(stmt->schema, stmt->tableName);
+Plan* Optimizer::createDeletePlanTree(const BoundStatement* bound) {
   Plan* plan;
 
-  ScanPlan* scan = new ScanPlan();
-  scan->type = kSeqScan;
-  scan->table = table;
-  plan = scan;
+  plan = createScanPlan(bound->table);
 
-  if (stmt->expr != nullptr) {
-    Plan* filter = createFilterPlan(table->columns(), stmt->expr);
-    filter->next = plan;
-    plan = filter;
+  if (bound->filterVal != nullptr) {
+    plan = createFilterPlan(bound, plan);
+  }
+  if (bound->subquery != nullptr) {
+    plan = createSemiJoinPlan(bound, plan);
   }
 
-  DeletePlan* del = new DeletePlan();
-  del->table = table;
+  DeletePlan* del = arena_->create<DeletePlan>();
+  del->table = bound->table;
   del->next = plan;
+  del->rows = plan->rows;
+  del->cost = plan->cost;
   return del;
 }
 
-Plan* Optimizer::createSelectPlanTree(const SelectStatement* stmt) {
-  Table* table =
-      g_meta_data.getTable(stmt->fromTable->schema, stmt->fromTable->name);
-  std::vector<ColumnDefinition*>* columns = table->columns();
+Plan* Optimizer::createSelectPlanTree(const BoundStatement* bound) {
+  std::vector<ColumnDefinition*>* columns = bound->table->columns();
   Plan* plan;
 
-  ScanPlan* scan = new ScanPlan();
-  scan->type = kSeqScan;
-  scan->table = table;
-  plan = scan;
+  /* DISTINCT and set operations hand over projected rows, the select prints
+  all of their columns. */
+  if (bound->distinct || !bound->setOps.empty()) {
+    plan = createProjectPlanTree(bound);
+    SelectPlan* select = arena_->create<SelectPlan>();
+    select->table = nullptr;
+    select->next = plan;
+    select->rows = plan->rows;
+    select->cost = plan->cost;
+    for (size_t i = 0; i < bound->colIds.size(); i++) {
+      select->outCols.push_back((*columns)[bound->colIds[i]]);
+      select->colIds.push_back(i);
+    }
+    return select;
+  }
 
-  if (stmt->whereClause != nullptr) {
-    Plan* filter = createFilterPlan(columns, stmt->whereClause);
-    filter->next = plan;
-    plan = filter;
+  plan = createScanPlan(bound->table);
+
+  if (bound->filterVal != nullptr) {
+    plan = createFilterPlan(bound, plan);
+  }
+  if (bound->subquery != nullptr) {
+    plan = createSemiJoinPlan(bound, plan);
+  }
+  if (bound->limit != nullptr) {
+    plan = createLimitPlan(bound->limit, plan);
   }
 
-  SelectPlan* select = new SelectPlan();
-  select->table = table;
+  SelectPlan* select = arena_->create<SelectPlan>();
+  select->table = bound->table;
   select->next = plan;
+  select->rows = plan->rows;
+  select->cost = plan->cost;
 
-  for (auto expr : *stmt->selectList) {
-    if (expr->type == kExprStar) {
-      for (size_t i = 0; i < columns->size(); i++) {
-        ColumnDefinition* col = (*columns)[i];
-        select->outCols.push_back(col);
-        select->colIds.push_back(i);
-      }
+  for (auto col_id : bound->colIds) {
+    select->outCols.push_back((*columns)[col_id]);
+    select->colIds.push_back(col_id);
+  }
+
+  return select;
+}
+
+/* The select list of a statement, without duplicates for DISTINCT. Each
+set operation takes the rows of the previous one on its left and the whole
+nested statement on its right. UNION ALL streams both sides, the other
+operations hash every row they read. */
+Plan* Optimizer::createProjectPlanTree(const BoundStatement* bound) {
+  Plan* plan = createScanPlan(bound->table);
+  if (bound->filterVal != nullptr) {
+    plan = createFilterPlan(bound, plan);
+  }
+  if (bound->subquery != nullptr) {
+    plan = createSemiJoinPlan(bound, plan);
+  }
+
+  ProjectionPlan* projection = arena_->create<ProjectionPlan>();
+  projection->table = bound->table;
+  projection->colIds = bound->colIds;
+  projection->next = plan;
+  projection->rows = plan->rows;
+  projection->cost = plan->cost;
+  plan = projection;
+
+  if (bound->distinct) {
+    DistinctPlan* distinct = arena_->create<DistinctPlan>();
+    distinct->next = plan;
+    distinct->rows =
+        EstimateDistinctRows(bound->table, bound->colIds, plan->rows);
+    distinct->cost = plan->cost + plan->rows * HASH_TUPLE_COST;
+    plan = distinct;
+  }
+  if (bound->limit != nullptr) {
+    plan = createLimitPlan(bound->limit, plan);
+  }
+
+  for (auto& bound_op : bound->setOps) {
+    SetOpPlan* set_op = arena_->create<SetOpPlan>();
+    set_op->type = bound_op.type;
+    set_op->all = bound_op.all;
+    set_op->next = plan;
+    set_op->right = createProjectPlanTree(bound_op.stmt);
+
+    double left = plan->rows;
+    double right = set_op->right->rows;
+    if (set_op->type == kSetUnion) {
+      set_op->rows = left + right;
+    } else if (set_op->type == kSetIntersect) {
+      set_op->rows = std::min(left, right);
     } else {
-      for (size_t i = 0; i < columns->size(); i++) {
-        ColumnDefinition* col = (*columns)[i];
-        if (strcmp(expr->name, col->name) == 0) {
-          select->outCols.push_back(col);
-          select->colIds.push_back(i);
-        }
-      }
+      set_op->rows = left;
+    }
+    set_op->cost = plan->cost + set_op->right->cost;
+    if (set_op->type != kSetUnion || !set_op->all) {
+      set_op->cost += (left + right) * HASH_TUPLE_COST;
+    }
+    plan = set_op;
+    if (bound_op.limit != nullptr) {
+      plan = createLimitPlan(bound_op.limit, plan);
     }
   }
 
-  return select;
+  return plan;
+}
+
+Plan* Optimizer::createScanPlan(Table* table) {
+  ScanPlan* scan = arena_->create<ScanPlan>();
+  scan->type = kSeqScan;
+  scan->table = table;
+  /* The live tuple count is exact and cheap, statistics are only needed for
+  what the predicates keep of it. */
+  scan->rows = table->tupleCount();
+  scan->cost = seqScanCost(scan->rows);
+  return scan;
 }
 
-Plan* Optimizer::createFilterPlan(std::vector<ColumnDefinition*>* columns,
-                                  Expr* where) {
-  FilterPlan* filter = new FilterPlan();
-  Expr* col = nullptr;
-  Expr* val = nullptr;
-  if (where->expr->type == kExprColumnRef) {
-    col = where->expr;
-    val = where->expr2;
+/* A filter on the partition column leaves one partition to scan. Values of
+prepared statements are only known when they run, the scan is costed with
+an average partition then. */
+void Optimizer::prunePartitions(ScanPlan* scan, FilterPlan* filter) {
+  Table* table = scan->table;
+  if (table->partitionColumn() != static_cast<int>(filter->idx)) {
+    return;
+  }
+
+  scan->pruneVal = filter->val;
+  const std::vector<Partition*>* parts = table->partitions();
+  if (filter->val->type == kExprParameter) {
+    scan->rows = parts->empty() ? 0 : scan->rows / parts->size();
   } else {
-    col = where->expr2;
-    val = where->expr;
+    int idx = table->partitionOf(filter->val);
+    scan->rows =
+        (idx < 0) ? 0 : (*parts)[idx]->getTableStore()->tupleCount();
   }
+  scan->cost = seqScanCost(scan->rows);
+}
 
-  for (size_t i = 0; i < columns->size(); i++) {
-    ColumnDefinition* col_def = (*columns)[i];
-    if (strcmp(col->name, col_def->name) == 0) {
-      filter->idx = i;
-    }
+Plan* Optimizer::createFilterPlan(const BoundStatement* bound, Plan* next) {
+  FilterPlan* filter = arena_->create<FilterPlan>();
+  filter->table = bound->table;
+  filter->idx = bound->filterColId;
+  filter->val = bound->filterVal;
+  filter->next = next;
+  if (next->planType == kScan) {
+    prunePartitions(static_cast<ScanPlan*>(next), filter);
   }
-  filter->val = val;
+
+  double sel = EstimateEqualSelectivity(filter->table, filter->idx,
+                                        filter->val);
+  /* Selectivity is over the whole table, pruning does not change what the
+  filter keeps. */
+  filter->rows = std::min(next->rows, filter->table->tupleCount() * sel);
+  filter->cost = next->cost + next->rows * FILTER_TUPLE_COST;
 
   return filter;
 }
 
+/* The subquery is run to build a hash table before the rows are probed.
+Without statistics on how its values overlap the column, half of the rows
+are assumed to match. */
+Plan* Optimizer::createSemiJoinPlan(const BoundStatement* bound, Plan* next) {
+  const BoundSubquery* subquery = bound->subquery;
+  SemiJoinPlan* join = arena_->create<SemiJoinPlan>();
+  join->table = bound->table;
+  join->anti = subquery->anti;
+  join->nullAware = subquery->nullAware;
+  join->keyed = subquery->keyed;
+  join->idx = subquery->colId;
+  join->next = next;
+  join->right = createProjectPlanTree(subquery->stmt);
+
+  double right = join->right->rows;
+  double matched = next->rows;
+  if (join->keyed) {
+    matched = std::min(next->rows * 0.5, right);
+  } else if (right == 0) {
+    matched = 0;
+  }
+  join->rows = join->anti ? next->rows - matched : matched;
+  join->cost = next->cost + join->right->cost +
+               (next->rows + right) * HASH_TUPLE_COST;
+  return join;
+}
+
+/* The limit stops its input once it has returned enough rows, but blocking
+inputs read everything first, so the cost is left as it is. */
+Plan* Optimizer::createLimitPlan(const LimitDescription* limit, Plan* next) {
+  LimitPlan* plan = arena_->create<LimitPlan>();
+  plan->limit = limit->limit;
+  plan->offset = limit->offset;
+  plan->next = next;
+  plan->rows = next->rows;
+  plan->cost = next->cost;
+
+  if (plan->offset != nullptr && plan->offset->type == kExprLiteralInt) {
+    plan->rows = std::max(0.0, plan->rows - plan->offset->ival);
+  }
+  if (plan->limit != nullptr && plan->limit->type == kExprLiteralInt) {
+    plan->rows = std::min(plan->rows, static_cast<double>(plan->limit->ival));
+  }
+  return plan;
+}
+
+double Optimizer::seqScanCost(double rows) { return rows * SEQ_TUPLE_COST; }
+
+/* Workers split the tuples, but every morsel is a task to schedule and the
+results have to be gathered, which small tables do not pay back. */
+double Optimizer::parallelScanCost(double rows, size_t workers) {
+  if (workers <= 1) {
+    return seqScanCost(rows) + PARALLEL_SETUP_COST;
+  }
+
+  double morsels = rows / MORSEL_SIZE + 1;
+  return rows * SEQ_TUPLE_COST / workers + morsels * PARALLEL_TASK_COST +
+         PARALLEL_SETUP_COST;
+}
+
 Plan* Optimizer::createTrxPlanTree(const TransactionStatement* stmt) {
-  TrxPlan* plan = new TrxPlan();
+  TrxPlan* plan = arena_->create<TrxPlan>();
   plan->command = stmt->command;
   return plan;
 }
 
 Plan* Optimizer::createShowPlanTree(const ShowStatement* stmt) {
-  ShowPlan* plan = new ShowPlan();
+  ShowPlan* plan = arena_->create<ShowPlan>();
   plan->type = stmt->type;
   plan->schema = stmt->schema;
   plan->name = stmt->name;
   plan->next = nullptr;
   return plan;
 }
+
+Plan* Optimizer::createPreparePlanTree(const PrepareStatement* stmt) {
+  PreparePlan* plan = arena_->create<PreparePlan>();
+  plan->name = stmt->name;
+  plan->query = stmt->query;
+  return plan;
+}
+
+Plan* Optimizer::createExecutePlanTree(const ExecuteStatement* stmt) {
+  ExecutePlan* plan = arena_->create<ExecutePlan>();
+  plan->name = stmt->name;
+  if (stmt->parameters != nullptr) {
+    plan->params = *stmt->parameters;
+  }
+  return plan;
+}
+
 }  // namespace bydb
\ No newline at end of file
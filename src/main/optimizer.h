@@ -1,6 +1,7 @@
 #pragma once
 
 #include "metadata.h"
+#include "parser.h"
 
 #include "sql/statements.h"
 
@@ -20,18 +21,39 @@ enum PlanType {
   kSort,
   kLimit,
   kTrx,
-  kShow
+  kShow,
+  kPrepare,
+  kExecute,
+  kAnalyze,
+  kExplain,
+  kTruncate,
+  kPartition,
+  kSetOp,
+  kDistinct,
+  kSemiJoin
 };
 
+/* Number of tuples handed to a worker at a time by the parallel scan. */
+#define MORSEL_SIZE 1000
+/* Morsels a pipelined parallel scan keeps queued per worker, ahead of the
+one it returns rows from. */
+#define MORSEL_WINDOW 2
+
+/* Cost units, relative to reading and parsing one tuple. */
+#define SEQ_TUPLE_COST 1.0
+#define FILTER_TUPLE_COST 0.25
+#define HASH_TUPLE_COST 0.5
+#define PARALLEL_SETUP_COST 10000.0
+#define PARALLEL_TASK_COST 200.0
+
+/* Plans are allocated from the statement's arena and released with it. */
 struct Plan {
-  Plan(PlanType t) : planType(t), next(nullptr) {}
-  ~Plan() {
-    delete next;
-    next = nullptr;
-  }
+  Plan(PlanType t) : planType(t), next(nullptr), rows(0), cost(0) {}
 
   PlanType planType;
   Plan* next;
+  double rows;  // estimated output rows
+  double cost;  // estimated total cost, see SEQ_TUPLE_COST
 };
 
 struct CreatePlan : public Plan {
@@ -43,6 +65,7 @@ struct CreatePlan : public Plan {
   char* indexName;
   std::vector<ColumnDefinition*>* indexColumns;
   std::vector<ColumnDefinition*>* columns;
+  const PartitionSpec* partition;
 };
 
 struct DropPlan : public Plan {
@@ -58,7 +81,7 @@ struct InsertPlan : public Plan {
   InsertPlan() : Plan(kInsert) {}
   InsertType type;
   Table* table;
-  std::vector<Expr*>* values;
+  std::vector<Expr*> values;  // one per column of the table
 };
 
 struct UpdatePlan : public Plan {
@@ -80,30 +103,67 @@ struct SelectPlan : public Plan {
   std::vector<size_t> colIds;
 };
 
-enum ScanType { kSeqScan, kIndexScan };
+/* Keeps the selected columns of each row, in the order of the select list. */
+struct ProjectionPlan : public Plan {
+  ProjectionPlan() : Plan(kProjection) {}
+  Table* table;
+  std::vector<size_t> colIds;
+};
 
-struct ScanPlan : public Plan {
-  ScanPlan() : Plan(kScan) {}
-  ScanType type;
+/* Removes duplicates of the projected rows of 'next'. */
+struct DistinctPlan : public Plan {
+  DistinctPlan() : Plan(kDistinct) {}
+};
+
+/* Combines the projected rows of 'next' with those of 'right'. */
+struct SetOpPlan : public Plan {
+  SetOpPlan() : Plan(kSetOp), right(nullptr) {}
+  SetType type;
+  bool all;
+  Plan* right;
+};
+
+/* Keeps the rows of 'next' which have a match among the rows of 'right',
+or which have none for an anti join. */
+struct SemiJoinPlan : public Plan {
+  SemiJoinPlan() : Plan(kSemiJoin), right(nullptr) {}
   Table* table;
+  bool anti;
+  bool nullAware;  // NOT IN
+  bool keyed;      // column 'idx' matches the column of 'right'
+  size_t idx;
+  Plan* right;
 };
 
 struct FilterPlan : public Plan {
-  FilterPlan() : Plan(kFilter), idx(0), val(nullptr) {}
+  FilterPlan() : Plan(kFilter), table(nullptr), idx(0), val(nullptr) {}
+  Table* table;
   size_t idx;
   Expr* val;
 };
 
+enum ScanType { kSeqScan, kIndexScan };
+
+struct ScanPlan : public Plan {
+  ScanPlan() : Plan(kScan), pruneVal(nullptr) {}
+  ScanType type;
+  Table* table;
+  /* Value of the partition column the filter above asks for, only the
+  partition it belongs to is scanned. Null to scan all of them. */
+  Expr* pruneVal;
+};
+
 struct SortPlan : public Plan {
   SortPlan() : Plan(kSort) {}
   Table* table;
   std::vector<OrderDescription*>* order;
 };
 
+/* Values may be parameters, they are bound when the plan runs. */
 struct LimitPlan : public Plan {
   LimitPlan() : Plan(kLimit) {}
-  uint64_t offset;
-  uint64_t limit;
+  Expr* limit;   // null for no limit
+  Expr* offset;  // may be null
 };
 
 struct TrxPlan : public Plan {
@@ -118,30 +178,92 @@ struct ShowPlan : public Plan {
   char* name;
 };
 
+struct PreparePlan : public Plan {
+  PreparePlan() : Plan(kPrepare) {}
+  char* name;
+  char* query;
+};
+
+struct ExecutePlan : public Plan {
+  ExecutePlan() : Plan(kExecute) {}
+  char* name;
+  std::vector<Expr*> params;
+};
+
+struct AnalyzePlan : public Plan {
+  AnalyzePlan() : Plan(kAnalyze) {}
+  Table* table;
+};
+
+struct TruncatePlan : public Plan {
+  TruncatePlan() : Plan(kTruncate) {}
+  Table* table;
+};
+
+/* ALTER TABLE ADD or DROP PARTITION. */
+struct PartitionPlan : public Plan {
+  PartitionPlan() : Plan(kPartition) {}
+  Table* table;
+  bool drop;
+  std::string name;
+  int64_t bound;
+};
+
+/* The plan explained hangs off 'plan' rather than 'next', its operators are
+only built for EXPLAIN ANALYZE. */
+struct ExplainPlan : public Plan {
+  ExplainPlan() : Plan(kExplain), analyze(false), plan(nullptr) {}
+  bool analyze;
+  Plan* plan;
+};
+
 class Optimizer {
  public:
-  Optimizer() {}
+  Optimizer(Arena* arena) : arena_(arena) {}
+
+  Plan* createPlanTree(const BoundStatement* bound);
+
+  Plan* createExtPlanTree(const ExtStatement* stmt);
 
-  Plan* createPlanTree(const SQLStatement* stmt);
+  static double seqScanCost(double rows);
+
+  static double parallelScanCost(double rows, size_t workers);
 
  private:
-  Plan* createCreatePlanTree(const CreateStatement* stmt);
+  Plan* createScanPlan(Table* table);
+
+  Plan* createCreatePlanTree(const CreateStatement* stmt,
+                             const PartitionSpec* partition);
 
   Plan* createDropPlanTree(const DropStatement* stmt);
 
-  Plan* createInsertPlanTree(const InsertStatement* stmt);
+  Plan* createInsertPlanTree(const BoundStatement* bound);
+
+  Plan* createUpdatePlanTree(const BoundStatement* bound);
 
-  Plan* createUpdatePlanTree(const UpdateStatement* stmt);
+  Plan* createDeletePlanTree(const BoundStatement* bound);
 
-  Plan* createDeletePlanTree(const DeleteStatement* stmt);
+  Plan* createSelectPlanTree(const BoundStatement* bound);
 
-  Plan* createSelectPlanTree(const SelectStatement* stmt);
+  Plan* createProjectPlanTree(const BoundStatement* bound);
 
-  Plan* createFilterPlan(std::vector<ColumnDefinition*>* columns, Expr* where);
+  Plan* createFilterPlan(const BoundStatement* bound, Plan* next);
+
+  void prunePartitions(ScanPlan* scan, FilterPlan* filter);
+
+  Plan* createSemiJoinPlan(const BoundStatement* bound, Plan* next);
+
+  Plan* createLimitPlan(const LimitDescription* limit, Plan* next);
 
   Plan* createTrxPlanTree(const TransactionStatement* stmt);
 
   Plan* createShowPlanTree(const ShowStatement* stmt);
+
+  Plan* createPreparePlanTree(const PrepareStatement* stmt);
+
+  Plan* createExecutePlanTree(const ExecuteStatement* stmt);
+
+  Arena* arena_;
 };
 
 }  // namespace bydb
\ No newline at end of file
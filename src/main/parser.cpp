@@ -1,22 +1,197 @@
 #include "parser.h"
 #include "metadata.h"
+#include "plan_cache.h"
 #include "util.h"
 
+#include <strings.h>
+#include <cctype>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <utility>
 
 using namespace hsql;
 
 namespace bydb {
 
-Parser::Parser() { result_ = nullptr; }
+Parser::Parser() {
+  result_ = nullptr;
+  extStmt_ = nullptr;
+}
 
 Parser::~Parser() {
+  for (auto bound : bound_) {
+    delete bound;
+  }
   delete result_;
   result_ = nullptr;
+  delete extStmt_;
+  extStmt_ = nullptr;
+}
+
+/* Split a statement into words, quoted strings and single symbols, and
+note where each of them starts. */
+static std::vector<std::string> Tokenize(const std::string& query,
+                                         std::vector<size_t>* offsets) {
+  std::vector<std::string> tokens;
+  size_t i = 0;
+  while (i < query.length()) {
+    char c = query[i];
+    if (isspace(c)) {
+      i++;
+      continue;
+    }
+
+    offsets->push_back(i);
+    if (isalnum(c) || c == '_') {
+      size_t start = i;
+      while (i < query.length() && (isalnum(query[i]) || query[i] == '_')) {
+        i++;
+      }
+      tokens.push_back(query.substr(start, i - start));
+    } else if (c == '\'') {
+      size_t end = query.find('\'', i + 1);
+      end = (end == std::string::npos) ? query.length() : end + 1;
+      tokens.push_back(query.substr(i, end - i));
+      i = end;
+    } else {
+      tokens.push_back(std::string(1, c));
+      i++;
+    }
+  }
+
+  if (!tokens.empty() && tokens.back() == ";") {
+    tokens.pop_back();
+    offsets->pop_back();
+  }
+  return tokens;
+}
+
+static bool IsKeyword(const std::string& token, const char* keyword) {
+  return strcasecmp(token.c_str(), keyword) == 0;
+}
+
+/* Skips the next token if it is 'keyword'. */
+static bool Expect(std::vector<std::string>& tokens, size_t& pos,
+                   const char* keyword) {
+  if (pos < tokens.size() && IsKeyword(tokens[pos], keyword)) {
+    pos++;
+    return true;
+  }
+  return false;
+}
+
+/* Position of PARTITION BY, the size of 'tokens' if there is none. */
+static size_t FindPartitionBy(std::vector<std::string>& tokens) {
+  for (size_t i = 1; i + 1 < tokens.size(); i++) {
+    if (IsKeyword(tokens[i], "partition") && IsKeyword(tokens[i + 1], "by")) {
+      return i;
+    }
+  }
+  return tokens.size();
+}
+
+/* VALUES LESS THAN (<integer> | MAXVALUE), the parentheses are optional. */
+static bool ParseBound(std::vector<std::string>& tokens, size_t& pos,
+                       int64_t* bound) {
+  if (!Expect(tokens, pos, "values") || !Expect(tokens, pos, "less") ||
+      !Expect(tokens, pos, "than")) {
+    return true;
+  }
+
+  bool paren = Expect(tokens, pos, "(");
+  if (Expect(tokens, pos, "maxvalue")) {
+    *bound = PARTITION_MAXVALUE;
+  } else {
+    bool negative = Expect(tokens, pos, "-");
+    if (pos >= tokens.size() || !isdigit(tokens[pos][0])) {
+      return true;
+    }
+    *bound = strtoll(tokens[pos++].c_str(), nullptr, 10);
+    if (negative) {
+      *bound = -*bound;
+    }
+  }
+  return paren && !Expect(tokens, pos, ")");
+}
+
+/* PARTITION BY RANGE (<column>) (PARTITION <name> VALUES LESS THAN (...),
+...) or PARTITION BY HASH (<column>) PARTITIONS <number>. */
+static bool ParsePartitionBy(std::vector<std::string>& tokens, size_t pos,
+                             PartitionSpec* spec) {
+  pos += 2;
+  bool range = Expect(tokens, pos, "range");
+  if (!range && !Expect(tokens, pos, "hash")) {
+    return true;
+  }
+  if (!Expect(tokens, pos, "(") || pos >= tokens.size()) {
+    return true;
+  }
+  spec->column = tokens[pos++];
+  if (!Expect(tokens, pos, ")")) {
+    return true;
+  }
+
+  if (range) {
+    spec->type = kPartitionRange;
+    if (!Expect(tokens, pos, "(")) {
+      return true;
+    }
+    do {
+      int64_t bound = 0;
+      if (!Expect(tokens, pos, "partition") || pos >= tokens.size()) {
+        return true;
+      }
+      spec->names.push_back(tokens[pos++]);
+      if (ParseBound(tokens, pos, &bound)) {
+        return true;
+      }
+      spec->bounds.push_back(bound);
+    } while (Expect(tokens, pos, ","));
+    if (!Expect(tokens, pos, ")")) {
+      return true;
+    }
+  } else {
+    spec->type = kPartitionHash;
+    if (!Expect(tokens, pos, "partitions") || pos >= tokens.size() ||
+        !isdigit(tokens[pos][0])) {
+      return true;
+    }
+    spec->hashNum = strtoul(tokens[pos++].c_str(), nullptr, 10);
+  }
+
+  return pos != tokens.size();
 }
 
 bool Parser::parseStatement(std::string query) {
+  std::vector<size_t> offsets;
+  std::vector<std::string> tokens = Tokenize(query, &offsets);
+  if (!tokens.empty() && IsKeyword(tokens[0], "explain")) {
+    return parseExplainStatement(query, tokens);
+  }
+  if (!tokens.empty() && IsKeyword(tokens[0], "create")) {
+    size_t pos = FindPartitionBy(tokens);
+    if (pos < tokens.size()) {
+      return parsePartitionedCreate(query, tokens, offsets, pos);
+    }
+  }
+  if (!tokens.empty() && IsKeyword(tokens[0], "alter")) {
+    for (auto& token : tokens) {
+      if (IsKeyword(token, "partition")) {
+        return parseAlterPartition(tokens);
+      }
+    }
+  }
+  if (!tokens.empty() &&
+      (IsKeyword(tokens[0], "analyze") || IsKeyword(tokens[0], "truncate"))) {
+    return parseExtStatement(tokens);
+  }
+
+  return parseSQLStatement(query);
+}
+
+bool Parser::parseSQLStatement(std::string& query) {
   result_ = new SQLParserResult;
   SQLParser::parse(query, result_);
 
@@ -29,10 +204,228 @@ bool Parser::parseStatement(std::string query) {
   return true;
 }
 
+bool Parser::parseExtStatement(std::vector<std::string>& tokens) {
+  size_t pos = 1;
+  extStmt_ = new ExtStatement(IsKeyword(tokens[0], "analyze")
+                                  ? kExtStmtAnalyze
+                                  : kExtStmtTruncate);
+  if (pos < tokens.size() && IsKeyword(tokens[pos], "table")) {
+    pos++;
+  }
+  if (parseTableName(tokens, pos, extStmt_)) {
+    return true;
+  }
+
+  if (pos != tokens.size()) {
+    std::cout << "[BYDB-Error]  Failed to parse sql statement." << std::endl;
+    return true;
+  }
+
+  if (g_meta_data.getTable(extStmt_->schema, extStmt_->name) == nullptr) {
+    std::cout << "[BYDB-Error]  Table "
+              << TableNameToString(extStmt_->schema, extStmt_->name)
+              << " did not exist!" << std::endl;
+    return true;
+  }
+
+  return false;
+}
+
+/* EXPLAIN [ANALYZE] wraps a statement of the sql parser, which is parsed and
+checked as usual once the prefix is cut off. */
+bool Parser::parseExplainStatement(std::string& query,
+                                   std::vector<std::string>& tokens) {
+  extStmt_ = new ExtStatement(kExtStmtExplain);
+  size_t pos = query.find_first_not_of(" \t\r\n") + strlen("explain");
+  if (tokens.size() > 1 && IsKeyword(tokens[1], "analyze")) {
+    extStmt_->analyze = true;
+    pos = query.find_first_not_of(" \t\r\n", pos) + strlen("analyze");
+  }
+
+  std::string sub_query = query.substr(pos);
+  if (parseSQLStatement(sub_query)) {
+    return true;
+  }
+
+  if (result_->size() != 1) {
+    std::cout << "[BYDB-Error]  Only one statement can be explained."
+              << std::endl;
+    return true;
+  }
+
+  extStmt_->stmt = bound_[0];
+  StatementType type = extStmt_->stmt->stmt->type();
+  if (type != kStmtSelect && type != kStmtInsert && type != kStmtUpdate &&
+      type != kStmtDelete) {
+    std::cout << "[BYDB-Error]  Not support to explain "
+              << StmtTypeToString(type) << " statement." << std::endl;
+    return true;
+  }
+
+  return false;
+}
+
+/* The sql parser does not know PARTITION BY, the statement is parsed by it
+without the clause. */
+bool Parser::parsePartitionedCreate(std::string& query,
+                                    std::vector<std::string>& tokens,
+                                    std::vector<size_t>& offsets, size_t pos) {
+  PartitionSpec spec;
+  if (ParsePartitionBy(tokens, pos, &spec)) {
+    std::cout << "[BYDB-Error]  Failed to parse sql statement." << std::endl;
+    return true;
+  }
+
+  std::string sub_query = query.substr(0, offsets[pos]);
+  if (parseSQLStatement(sub_query)) {
+    return true;
+  }
+
+  const SQLStatement* stmt = bound_[0]->stmt;
+  if (bound_.size() != 1 || stmt->type() != kStmtCreate ||
+      static_cast<const CreateStatement*>(stmt)->type != kCreateTable) {
+    std::cout << "[BYDB-Error]  Only one CREATE TABLE can be partitioned."
+              << std::endl;
+    return true;
+  }
+
+  ColumnDefinition* col = nullptr;
+  for (auto col_def : *static_cast<const CreateStatement*>(stmt)->columns) {
+    if (spec.column == col_def->name) {
+      col = col_def;
+    }
+  }
+  if (col == nullptr) {
+    std::cout << "[BYDB-Error]  Partition column " << spec.column
+              << " did not exist!" << std::endl;
+    return true;
+  }
+
+  size_t part_num =
+      (spec.type == kPartitionRange) ? spec.names.size() : spec.hashNum;
+  if (part_num == 0 || part_num > PARTITION_MAX_NUM) {
+    std::cout << "[BYDB-Error]  Number of partitions should be between 1 and "
+              << PARTITION_MAX_NUM << "." << std::endl;
+    return true;
+  }
+
+  if (spec.type == kPartitionRange) {
+    if (col->type.data_type != DataType::INT &&
+        col->type.data_type != DataType::LONG) {
+      std::cout << "[BYDB-Error]  Range partition column should be INT or "
+                   "LONG."
+                << std::endl;
+      return true;
+    }
+    for (size_t i = 1; i < part_num; i++) {
+      if (spec.bounds[i - 1] == PARTITION_MAXVALUE ||
+          spec.bounds[i] <= spec.bounds[i - 1]) {
+        std::cout << "[BYDB-Error]  Partition bounds should be ascending."
+                  << std::endl;
+        return true;
+      }
+      for (size_t j = 0; j < i; j++) {
+        if (spec.names[i] == spec.names[j]) {
+          std::cout << "[BYDB-Error]  Partition " << spec.names[i]
+                    << " is duplicated." << std::endl;
+          return true;
+        }
+      }
+    }
+  }
+
+  bound_[0]->partition = spec;
+  return false;
+}
+
+/* ALTER TABLE <table> ADD PARTITION <name> VALUES LESS THAN (...), or DROP
+PARTITION <name>. Only range partitions can be added or dropped, hash
+partitions would have to move their rows. */
+bool Parser::parseAlterPartition(std::vector<std::string>& tokens) {
+  size_t pos = 1;
+  extStmt_ = new ExtStatement(kExtStmtAddPartition);
+  Expect(tokens, pos, "table");
+  if (parseTableName(tokens, pos, extStmt_)) {
+    return true;
+  }
+
+  bool drop = Expect(tokens, pos, "drop");
+  bool parsed = (drop || Expect(tokens, pos, "add")) &&
+                Expect(tokens, pos, "partition") && pos < tokens.size();
+  if (parsed) {
+    extStmt_->partition = tokens[pos++];
+    parsed = drop || !ParseBound(tokens, pos, &extStmt_->bound);
+  }
+  if (!parsed || pos != tokens.size()) {
+    std::cout << "[BYDB-Error]  Failed to parse sql statement." << std::endl;
+    return true;
+  }
+  if (drop) {
+    extStmt_->type = kExtStmtDropPartition;
+  }
+
+  Table* table = g_meta_data.getTable(extStmt_->schema, extStmt_->name);
+  if (table == nullptr) {
+    std::cout << "[BYDB-Error]  Table "
+              << TableNameToString(extStmt_->schema, extStmt_->name)
+              << " did not exist!" << std::endl;
+    return true;
+  }
+  if (table->partitionType() != kPartitionRange) {
+    std::cout << "[BYDB-Error]  Only tables partitioned by range can add or "
+                 "drop partitions."
+              << std::endl;
+    return true;
+  }
+
+  const std::vector<Partition*>* parts = table->partitions();
+  bool exists = table->getPartition(extStmt_->partition.c_str()) != nullptr;
+  if (drop && !exists) {
+    std::cout << "[BYDB-Error]  Partition " << extStmt_->partition
+              << " did not exist!" << std::endl;
+    return true;
+  }
+  if (!drop && exists) {
+    std::cout << "[BYDB-Error]  Partition " << extStmt_->partition
+              << " already existed!" << std::endl;
+    return true;
+  }
+  if (!drop && !parts->empty() &&
+      (parts->back()->bound() == PARTITION_MAXVALUE ||
+       extStmt_->bound <= parts->back()->bound())) {
+    std::cout << "[BYDB-Error]  Partition bounds should be ascending."
+              << std::endl;
+    return true;
+  }
+  if (!drop && parts->size() >= PARTITION_MAX_NUM) {
+    std::cout << "[BYDB-Error]  Number of partitions should be between 1 and "
+              << PARTITION_MAX_NUM << "." << std::endl;
+    return true;
+  }
+
+  return false;
+}
+
+bool Parser::parseTableName(std::vector<std::string>& tokens, size_t& pos,
+                            ExtStatement* stmt) {
+  if (pos + 2 >= tokens.size() || tokens[pos + 1] != ".") {
+    std::cout << "[BYDB-Error]: Schema and table name should be specified in "
+                 "the query, like 'db.t'."
+              << std::endl;
+    return true;
+  }
+
+  stmt->schema = strdup(tokens[pos].c_str());
+  stmt->name = strdup(tokens[pos + 2].c_str());
+  pos += 3;
+  return false;
+}
+
 bool Parser::checkStmtsMeta() {
   for (size_t i = 0; i < result_->size(); ++i) {
-    const SQLStatement* stmt = result_->getStatement(i);
-    if (checkMeta(stmt)) {
+    BoundStatement* bound = new BoundStatement(result_->getStatement(i));
+    bound_.push_back(bound);
+    if (checkMeta(bound)) {
       return true;
     }
   }
@@ -40,20 +433,26 @@ bool Parser::checkStmtsMeta() {
   return false;
 }
 
-bool Parser::checkMeta(const SQLStatement* stmt) {
+/* Checking a statement binds it as well, names are resolved only here. */
+bool Parser::checkMeta(BoundStatement* bound) {
+  const SQLStatement* stmt = bound->stmt;
   switch (stmt->type()) {
     case kStmtSelect:
-      return checkSelectStmt(static_cast<const SelectStatement*>(stmt));
+      return checkSelectStmt(static_cast<const SelectStatement*>(stmt), bound);
     case kStmtInsert:
-      return checkInsertStmt(static_cast<const InsertStatement*>(stmt));
+      return checkInsertStmt(static_cast<const InsertStatement*>(stmt), bound);
     case kStmtUpdate:
-      return checkUpdateStmt(static_cast<const UpdateStatement*>(stmt));
+      return checkUpdateStmt(static_cast<const UpdateStatement*>(stmt), bound);
     case kStmtDelete:
-      return checkDeleteStmt(static_cast<const DeleteStatement*>(stmt));
+      return checkDeleteStmt(static_cast<const DeleteStatement*>(stmt), bound);
     case kStmtCreate:
       return checkCreateStmt(static_cast<const CreateStatement*>(stmt));
     case kStmtDrop:
       return checkDropStmt(static_cast<const DropStatement*>(stmt));
+    case kStmtPrepare:
+      return checkPrepareStmt(static_cast<const PrepareStatement*>(stmt));
+    case kStmtExecute:
+      return checkExecuteStmt(static_cast<const ExecuteStatement*>(stmt));
     case kStmtTransaction:
     case kStmtShow:
       return false;
@@ -66,7 +465,9 @@ bool Parser::checkMeta(const SQLStatement* stmt) {
   return true;
 }
 
-bool Parser::checkSelectStmt(const SelectStatement* stmt) {
+/* Subqueries are bound with the statement they are part of as 'outer'. */
+bool Parser::checkSelectStmt(const SelectStatement* stmt,
+                             BoundStatement* bound, BoundStatement* outer) {
   TableRef* table_ref = stmt->fromTable;
   Table* table = getTable(table_ref);
   if (table == nullptr) {
@@ -81,13 +482,6 @@ bool Parser::checkSelectStmt(const SelectStatement* stmt) {
     return true;
   }
 
-  if (stmt->setOperations != nullptr) {
-    std::cout << "[BYDB-Error]  Do not support Set Operation like 'UNION', "
-                 "'Intersect', ect."
-              << std::endl;
-    return true;
-  }
-
   if (stmt->withDescriptions != nullptr) {
     std::cout << "[BYDB-Error]  Do not support 'with' clause." << std::endl;
     return true;
@@ -98,18 +492,30 @@ bool Parser::checkSelectStmt(const SelectStatement* stmt) {
     return true;
   }
 
+  bound->table = table;
+  bound->alias =
+      (table_ref->alias != nullptr) ? table_ref->alias->name : table_ref->name;
+  bound->distinct = stmt->selectDistinct;
   if (stmt->selectList != nullptr) {
     for (auto expr : *stmt->selectList) {
-      if (checkExpr(table, expr)) {
+      if (expr->type == kExprStar) {
+        for (size_t i = 0; i < table->columns()->size(); i++) {
+          bound->colIds.push_back(i);
+        }
+      } else if (expr->type == kExprColumnRef) {
+        size_t col_id;
+        if (checkColumn(table, expr->name, &col_id)) {
+          return true;
+        }
+        bound->colIds.push_back(col_id);
+      } else if (checkExpr(table, expr)) {
         return true;
       }
     }
   }
 
-  if (stmt->whereClause != nullptr) {
-    if (checkExpr(table, stmt->whereClause)) {
-      return true;
-    }
+  if (checkWhere(table, stmt->whereClause, bound, outer)) {
+    return true;
   }
 
   if (stmt->order != nullptr) {
@@ -121,21 +527,94 @@ bool Parser::checkSelectStmt(const SelectStatement* stmt) {
   }
 
   if (stmt->limit != nullptr) {
-    if (checkExpr(table, stmt->limit->limit)) {
+    if (checkLimit(stmt->limit)) {
       return true;
     }
-    if (checkExpr(table, stmt->limit->offset)) {
+    bound->limit = stmt->limit;
+  }
+
+  return checkSetOperations(stmt, bound);
+}
+
+/* LIMIT ALL leaves the limit null. Parameters are checked once they are
+bound, when the statement is executed. */
+bool Parser::checkLimit(const LimitDescription* limit) {
+  for (Expr* expr : {limit->limit, limit->offset}) {
+    if (expr == nullptr || expr->type == kExprParameter ||
+        (expr->type == kExprLiteralInt && expr->ival >= 0)) {
+      continue;
+    }
+    std::cout << "[BYDB-Error]  LIMIT and OFFSET should be non-negative "
+                 "integers."
+              << std::endl;
+    return true;
+  }
+  return false;
+}
+
+static bool IsIntType(DataType type) {
+  return type == DataType::INT || type == DataType::LONG;
+}
+
+/* Rows of both sides of a set operation are compared column by column, so
+they need as many columns, integers where integers are and strings where
+strings are. The columns are named after the first select. */
+bool Parser::checkSetOperations(const SelectStatement* stmt,
+                                BoundStatement* bound) {
+  if (stmt->setOperations == nullptr) {
+    return false;
+  }
+
+  std::vector<ColumnDefinition*>* columns = bound->table->columns();
+  for (auto set_op : *stmt->setOperations) {
+    if (set_op->resultOrder != nullptr) {
+      std::cout << "[BYDB-Error]  Do not support 'Order By' on the result of "
+                   "a set operation."
+                << std::endl;
+      return true;
+    }
+    if (set_op->resultLimit != nullptr && checkLimit(set_op->resultLimit)) {
+      return true;
+    }
+
+    BoundStatement* nested =
+        new BoundStatement(set_op->nestedSelectStatement);
+    bound->setOps.push_back(
+        {set_op->setType, set_op->isAll, nested, set_op->resultLimit});
+    if (checkSelectStmt(set_op->nestedSelectStatement, nested)) {
       return true;
     }
+
+    if (nested->colIds.size() != bound->colIds.size()) {
+      std::cout << "[BYDB-Error]  Both sides of a set operation should "
+                   "select the same number of columns."
+                << std::endl;
+      return true;
+    }
+
+    std::vector<ColumnDefinition*>* nested_cols = nested->table->columns();
+    for (size_t i = 0; i < bound->colIds.size(); i++) {
+      ColumnDefinition* col = (*columns)[bound->colIds[i]];
+      ColumnDefinition* nested_col = (*nested_cols)[nested->colIds[i]];
+      if (IsIntType(col->type.data_type) !=
+          IsIntType(nested_col->type.data_type)) {
+        std::cout << "[BYDB-Error]  Column " << col->name
+                  << " can not be combined with column " << nested_col->name
+                  << " of another type." << std::endl;
+        return true;
+      }
+    }
   }
 
   return false;
 }
 
-bool Parser::checkInsertStmt(const InsertStatement* stmt) {
+bool Parser::checkInsertStmt(const InsertStatement* stmt,
+                             BoundStatement* bound) {
   if (stmt->type == kInsertSelect) {
     std::cout << "[BYDB-Error]  Do not support 'INSERT INTO ... SELECT ...'."
               << std::endl;
+    return true;
   }
 
   Table* table = g_meta_data.getTable(stmt->schema, stmt->tableName);
@@ -145,52 +624,62 @@ bool Parser::checkInsertStmt(const InsertStatement* stmt) {
     return true;
   }
 
-  if (stmt->columns != nullptr) {
-    for (auto col_name : *stmt->columns) {
-      if (checkColumn(table, col_name)) {
+  if (stmt->columns != nullptr &&
+      stmt->columns->size() != stmt->values->size()) {
+    std::cout << "[BYDB-Error]  Column count doesn't match value count."
+              << std::endl;
+    return true;
+  }
+
+  if (stmt->values->size() > table->columns()->size()) {
+    std::cout << "[BYDB-Error]  Too many values for table "
+              << TableNameToString(stmt->schema, stmt->tableName) << std::endl;
+    return true;
+  }
+
+  /* Line the values up with the columns of the table. */
+  bound->table = table;
+  bound->values.assign(table->columns()->size(), nullptr);
+  for (size_t i = 0; i < stmt->values->size(); i++) {
+    size_t col_id = i;
+    if (stmt->columns != nullptr) {
+      char* col_name = (*stmt->columns)[i];
+      if (checkColumn(table, col_name, &col_id)) {
+        return true;
+      }
+      if (bound->values[col_id] != nullptr) {
+        std::cout << "[BYDB-Error]  Column " << col_name
+                  << " specified more than once." << std::endl;
         return true;
       }
     }
+    bound->values[col_id] = (*stmt->values)[i];
   }
 
-  /* Prepare values for each columns in the table.
-  If value was not provided for some columns, add NULL expr for then. */
-  std::vector<Expr*> new_values;
+  /* Check the value of each column in the table. Columns which were not
+  given a value will get NULL. */
   for (size_t i = 0; i < table->columns()->size(); i++) {
     auto col_def = (*table->columns())[i];
-    if (stmt->columns != nullptr) {
-      size_t j;
-      for (j = 0; j < stmt->columns->size(); j++) {
-        if (strcmp(col_def->name, (*stmt->columns)[j])) {
-          break;
-        }
-      }
-      if (j < stmt->columns->size()) {
-        new_values.push_back((*stmt->values)[j]);
-      } else {
-        Expr* e = new Expr(kExprLiteralNull);
-        new_values.push_back(e);
-      }
-    } else {
-      if (i < stmt->values->size()) {
-        new_values.push_back((*stmt->values)[i]);
-      } else {
-        Expr* e = new Expr(kExprLiteralNull);
-        new_values.push_back(e);
+    Expr* value = bound->values[i];
+    if (value == nullptr) {
+      if (!col_def->nullable) {
+        std::cout << "[BYDB-Error]  Column " << col_def->name
+                  << " can not be NULL" << std::endl;
+        return true;
       }
+      continue;
     }
-  }
 
-  stmt->values->assign(new_values.begin(), new_values.end());
-
-  if (checkValues(table->columns(), stmt->values)) {
-    return true;
+    if (value->type != kExprParameter && CheckColumnValue(col_def, value)) {
+      return true;
+    }
   }
 
   return false;
 }
 
-bool Parser::checkUpdateStmt(const UpdateStatement* stmt) {
+bool Parser::checkUpdateStmt(const UpdateStatement* stmt,
+                             BoundStatement* bound) {
   TableRef* table_ref = stmt->table;
   Table* table = getTable(table_ref);
   if (table == nullptr) {
@@ -200,25 +689,40 @@ bool Parser::checkUpdateStmt(const UpdateStatement* stmt) {
     return true;
   }
 
+  bound->table = table;
+  bound->alias =
+      (table_ref->alias != nullptr) ? table_ref->alias->name : table_ref->name;
   if (stmt->updates != nullptr) {
     for (auto update : *stmt->updates) {
-      if (checkColumn(table, update->column)) {
+      size_t col_id;
+      if (checkColumn(table, update->column, &col_id)) {
         return true;
       }
-      if (checkExpr(table, update->value)) {
+      ColumnDefinition* col_def = (*table->columns())[col_id];
+      /* Rows never move between partitions. */
+      if (static_cast<int>(col_id) == table->partitionColumn()) {
+        std::cout << "[BYDB-Error]  Partition column " << col_def->name
+                  << " can not be updated." << std::endl;
         return true;
       }
+      if (update->value->type != kExprParameter &&
+          CheckColumnValue(col_def, update->value)) {
+        return true;
+      }
+      bound->colIds.push_back(col_id);
+      bound->values.push_back(update->value);
     }
   }
 
-  if (checkExpr(table, stmt->where)) {
+  if (checkWhere(table, stmt->where, bound)) {
     return true;
   }
 
   return false;
 }
 
-bool Parser::checkDeleteStmt(const DeleteStatement* stmt) {
+bool Parser::checkDeleteStmt(const DeleteStatement* stmt,
+                             BoundStatement* bound) {
   Table* table = g_meta_data.getTable(stmt->schema, stmt->tableName);
   if (table == nullptr) {
     std::cout << "[BYDB-Error]  Can not find table "
@@ -226,7 +730,9 @@ bool Parser::checkDeleteStmt(const DeleteStatement* stmt) {
     return true;
   }
 
-  if (checkExpr(table, stmt->expr)) {
+  bound->table = table;
+  bound->alias = stmt->tableName;
+  if (checkWhere(table, stmt->expr, bound)) {
     return true;
   }
 
@@ -250,11 +756,13 @@ Table* Parser::getTable(TableRef* table_ref) {
   return table;
 }
 
-bool Parser::checkColumn(Table* table, char* col_name) {
-  for (auto col_def : *table->columns()) {
-    if (strcmp(col_name, col_def->name) == 0) {
-      return false;
+bool Parser::checkColumn(Table* table, char* col_name, size_t* col_id) {
+  int id = table->getColumnId(col_name);
+  if (id >= 0) {
+    if (col_id != nullptr) {
+      *col_id = id;
     }
+    return false;
   }
 
   std::cout << "[BYDB-Error]  Can not find column " << col_name << " in table "
@@ -263,11 +771,16 @@ bool Parser::checkColumn(Table* table, char* col_name) {
 }
 
 bool Parser::checkExpr(Table* table, Expr* expr) {
+  if (expr == nullptr) {
+    return false;
+  }
+
   switch (expr->type) {
     case kExprLiteralFloat:
     case kExprLiteralString:
     case kExprLiteralInt:
     case kExprStar:
+    case kExprParameter:
       return false;
     case kExprSelect:
       return checkExpr(table, expr->expr);
@@ -295,46 +808,224 @@ bool Parser::checkExpr(Table* table, Expr* expr) {
   return false;
 }
 
-bool Parser::checkValues(std::vector<ColumnDefinition*>* columns,
-                         std::vector<Expr*>* values) {
-  for (size_t i = 0; i < columns->size(); i++) {
-    auto col_def = (*columns)[i];
-    auto expr = (*values)[i];
+static bool IsSubquery(Expr* expr) {
+  if (expr->type == kExprOperator && expr->opType == kOpNot &&
+      expr->expr != nullptr) {
+    expr = expr->expr;
+  }
+  return expr->type == kExprOperator && expr->select != nullptr &&
+         (expr->opType == kOpIn || expr->opType == kOpExists);
+}
 
-    switch (col_def->type.data_type) {
-      case DataType::INT:
-      case DataType::LONG:
-        if (expr->type != kExprLiteralInt) {
-          std::cout << "[BYDB-Error]  Invalid insert value type "
-                    << ExprTypeToString(expr->type) << " for column "
-                    << col_def->name << std::endl;
-          return true;
-        }
-        if (col_def->type.data_type == DataType::INT &&
-            expr->ival > INT32_MAX) {
-          std::cout << "[BYDB-Error]  The value " << expr->ival
-                    << " exceed the limitation of INT32_MAX" << std::endl;
-          return true;
-        }
-        break;
-      case DataType::CHAR:
-      case DataType::VARCHAR:
-        if (expr->type != kExprLiteralString) {
-          std::cout << "[BYDB-Error]  Invalid insert value type "
-                    << ExprTypeToString(expr->type) << " for column "
-                    << col_def->name << std::endl;
-          return true;
-        }
-        if (strlen(expr->name) > static_cast<size_t>(col_def->type.length)) {
-          std::cout << "[BYDB-Error]  The value '" << expr->name
-                    << "' is too long for column " << col_def->name
-                    << std::endl;
-          return true;
-        }
-        break;
-      default:
-        return true;
-        break;
+/* Filters compare one column with a value, either side of the operator, or
+test a subquery. The where clause of a subquery may instead compare one of
+its columns with a column of the outer statement. */
+bool Parser::checkWhere(Table* table, Expr* where, BoundStatement* bound,
+                        BoundStatement* outer) {
+  if (where == nullptr) {
+    return false;
+  }
+
+  if (IsSubquery(where)) {
+    return checkSubquery(table, where, bound);
+  }
+
+  if (outer != nullptr) {
+    bool correlated = false;
+    if (checkCorrelation(where, bound, outer, &correlated)) {
+      return true;
+    }
+    if (correlated) {
+      return false;
+    }
+  }
+
+  if (checkExpr(table, where)) {
+    return true;
+  }
+
+  Expr* col = nullptr;
+  Expr* val = nullptr;
+  if (where->type == kExprOperator && where->expr != nullptr &&
+      where->expr2 != nullptr) {
+    if (where->expr->type == kExprColumnRef) {
+      col = where->expr;
+      val = where->expr2;
+    } else if (where->expr2->type == kExprColumnRef) {
+      col = where->expr2;
+      val = where->expr;
+    }
+  }
+
+  if (col == nullptr || val->type == kExprColumnRef) {
+    std::cout << "[BYDB-Error]  Where clause should compare a column with a "
+                 "value."
+              << std::endl;
+    return true;
+  }
+
+  checkColumn(table, col->name, &bound->filterColId);
+  bound->filterVal = val;
+  return false;
+}
+
+/* A column is the outer statement's if it is qualified with the outer
+table's name, or if only the outer table has it. */
+static bool IsOuterColumn(Expr* col, BoundStatement* inner,
+                          BoundStatement* outer) {
+  if (col->type != kExprColumnRef) {
+    return false;
+  }
+  if (col->table != nullptr) {
+    return strcmp(col->table, outer->alias) == 0 &&
+           strcmp(col->table, inner->alias) != 0;
+  }
+  return inner->table->getColumnId(col->name) < 0 &&
+         outer->table->getColumnId(col->name) >= 0;
+}
+
+bool Parser::checkCorrelation(Expr* where, BoundStatement* bound,
+                              BoundStatement* outer, bool* correlated) {
+  if (where->type != kExprOperator || where->opType != kOpEquals ||
+      where->expr == nullptr || where->expr2 == nullptr) {
+    return false;
+  }
+
+  Expr* inner_col = where->expr;
+  Expr* outer_col = where->expr2;
+  if (IsOuterColumn(inner_col, bound, outer)) {
+    std::swap(inner_col, outer_col);
+  }
+  if (inner_col->type != kExprColumnRef ||
+      !IsOuterColumn(outer_col, bound, outer) ||
+      IsOuterColumn(inner_col, bound, outer)) {
+    return false;
+  }
+
+  size_t outer_id = 0;
+  if (checkColumn(bound->table, inner_col->name, &bound->filterColId) ||
+      checkColumn(outer->table, outer_col->name, &outer_id)) {
+    return true;
+  }
+
+  ColumnDefinition* col = (*bound->table->columns())[bound->filterColId];
+  ColumnDefinition* outer_def = (*outer->table->columns())[outer_id];
+  if (IsIntType(col->type.data_type) !=
+      IsIntType(outer_def->type.data_type)) {
+    std::cout << "[BYDB-Error]  Column " << col->name
+              << " can not be compared with column " << outer_def->name
+              << " of another type." << std::endl;
+    return true;
+  }
+
+  bound->outerColId = outer_id;
+  *correlated = true;
+  return false;
+}
+
+/* Subqueries run once, not once per row: the rows are matched with what the
+subquery returns, by a hash join on the column of IN or on the columns a
+correlated EXISTS compares. */
+bool Parser::checkSubquery(Table* table, Expr* where, BoundStatement* bound) {
+  BoundSubquery* subquery = new BoundSubquery();
+  bound->subquery = subquery;
+  Expr* expr = where;
+  if (expr->opType == kOpNot) {
+    subquery->anti = true;
+    expr = expr->expr;
+  }
+
+  BoundStatement* inner = new BoundStatement(expr->select);
+  subquery->stmt = inner;
+  if (checkSelectStmt(expr->select, inner, bound)) {
+    return true;
+  }
+
+  if (inner->outerColId >= 0 && !inner->setOps.empty()) {
+    std::cout << "[BYDB-Error]  Correlated subqueries can not have set "
+                 "operations."
+              << std::endl;
+    return true;
+  }
+
+  if (expr->opType == kOpExists) {
+    if (inner->outerColId >= 0) {
+      subquery->keyed = true;
+      subquery->colId = inner->outerColId;
+      inner->colIds.assign(1, inner->filterColId);
+    }
+    return false;
+  }
+
+  if (inner->outerColId >= 0) {
+    std::cout << "[BYDB-Error]  Subqueries of IN can not refer to the outer "
+                 "table."
+              << std::endl;
+    return true;
+  }
+  if (expr->expr->type != kExprColumnRef) {
+    std::cout << "[BYDB-Error]  Only a column can be tested with IN."
+              << std::endl;
+    return true;
+  }
+  if (checkColumn(table, expr->expr->name, &subquery->colId)) {
+    return true;
+  }
+  if (inner->colIds.size() != 1) {
+    std::cout << "[BYDB-Error]  Subqueries of IN should select one column."
+              << std::endl;
+    return true;
+  }
+
+  ColumnDefinition* col = (*table->columns())[subquery->colId];
+  ColumnDefinition* inner_col = (*inner->table->columns())[inner->colIds[0]];
+  if (IsIntType(col->type.data_type) !=
+      IsIntType(inner_col->type.data_type)) {
+    std::cout << "[BYDB-Error]  Column " << col->name
+              << " can not be compared with column " << inner_col->name
+              << " of another type." << std::endl;
+    return true;
+  }
+
+  subquery->keyed = true;
+  subquery->nullAware = subquery->anti;
+  return false;
+}
+
+bool Parser::checkPrepareStmt(const PrepareStatement* stmt) {
+  if (stmt->name == nullptr || stmt->query == nullptr) {
+    std::cout << "[BYDB-Error]  Invalid 'Prepare' statement." << std::endl;
+    return true;
+  }
+
+  /* The query itself is checked when it is prepared. */
+  return false;
+}
+
+bool Parser::checkExecuteStmt(const ExecuteStatement* stmt) {
+  CachedPlan* prepared = g_plan_cache.findPrepared(stmt->name);
+  if (prepared == nullptr) {
+    std::cout << "[BYDB-Error]  Prepared statement " << stmt->name
+              << " did not exist!" << std::endl;
+    return true;
+  }
+
+  size_t param_num =
+      (stmt->parameters == nullptr) ? 0 : stmt->parameters->size();
+  if (param_num != prepared->paramNum) {
+    std::cout << "[BYDB-Error]  Prepared statement " << stmt->name
+              << " expects " << prepared->paramNum << " parameters, got "
+              << param_num << std::endl;
+    return true;
+  }
+
+  for (size_t i = 0; i < param_num; i++) {
+    Expr* expr = (*stmt->parameters)[i];
+    if (expr->type != kExprLiteralInt && expr->type != kExprLiteralFloat &&
+        expr->type != kExprLiteralString && expr->type != kExprLiteralNull) {
+      std::cout << "[BYDB-Error]  Parameters of 'Execute' should be literals."
+                << std::endl;
+      return true;
     }
   }
 
@@ -440,6 +1131,15 @@ bool Parser::checkDropStmt(const DropStatement* stmt) {
       }
       break;
     }
+    case kDropPreparedStatement: {
+      if (g_plan_cache.findPrepared(stmt->name) == nullptr &&
+          !stmt->ifExists) {
+        std::cout << "[BYDB-Error]  Prepared statement " << stmt->name
+                  << " did not exist!" << std::endl;
+        return true;
+      }
+      break;
+    }
     case kDropIndex: {
       if (g_meta_data.getIndex(stmt->schema, stmt->name, stmt->indexName) ==
               nullptr &&
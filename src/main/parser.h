@@ -8,6 +8,108 @@
 using namespace hsql;
 
 namespace bydb {
+
+struct BoundStatement;
+
+/* Where clause 'column [NOT] IN (select)' or '[NOT] EXISTS (select)'. */
+struct BoundSubquery {
+  BoundSubquery()
+      : anti(false), nullAware(false), keyed(false), colId(0), stmt(nullptr) {}
+  ~BoundSubquery();
+
+  bool anti;       // NOT IN or NOT EXISTS
+  bool nullAware;  // NOT IN, a NULL in the subquery matches every row
+  /* Rows are matched on column 'colId' with the single column the subquery
+  selects. Uncorrelated EXISTS only asks if the subquery has rows. */
+  bool keyed;
+  size_t colId;
+  BoundStatement* stmt;
+};
+
+/* A select combined with the rows of the statement before it. */
+struct BoundSetOperation {
+  SetType type;
+  bool all;
+  BoundStatement* stmt;           // owned by the statement combined with it
+  const LimitDescription* limit;  // on the combined rows, may be null
+};
+
+/* A statement with its table and column references resolved while it is
+checked, the optimizer builds the plan from it without looking names up. */
+struct BoundStatement {
+  BoundStatement(const SQLStatement* s)
+      : stmt(s),
+        table(nullptr),
+        alias(nullptr),
+        distinct(false),
+        limit(nullptr),
+        filterColId(0),
+        filterVal(nullptr),
+        outerColId(-1),
+        subquery(nullptr) {}
+  ~BoundStatement() {
+    for (auto& set_op : setOps) {
+      delete set_op.stmt;
+    }
+    delete subquery;
+  }
+
+  const SQLStatement* stmt;
+  Table* table;                // select, insert, update and delete
+  const char* alias;           // name qualifying the columns of 'table'
+  std::vector<size_t> colIds;  // select list, or the columns updated
+  bool distinct;               // select
+  /* Select: LIMIT and OFFSET, null without them. */
+  const LimitDescription* limit;
+  /* Update: the value of each of colIds. Insert: one per column of the table,
+  null where the query gave none. */
+  std::vector<Expr*> values;
+  /* Where clause 'column = value', filterVal is null without one. */
+  size_t filterColId;
+  Expr* filterVal;
+  /* Subquery: where clause 'column = outer column', filterColId equals the
+  column of the outer statement with this id. -1 if uncorrelated. */
+  int outerColId;
+  BoundSubquery* subquery;
+  PartitionSpec partition;  // create table
+  /* Select: UNION, INTERSECT and EXCEPT, applied in this order to the rows
+  of the statement, each to the result of the previous one. */
+  std::vector<BoundSetOperation> setOps;
+};
+
+inline BoundSubquery::~BoundSubquery() { delete stmt; }
+
+/* Statements the sql parser does not know about, parsed by bydb itself. */
+enum ExtStmtType {
+  kExtStmtAnalyze,
+  kExtStmtExplain,
+  kExtStmtTruncate,
+  kExtStmtAddPartition,
+  kExtStmtDropPartition
+};
+
+struct ExtStatement {
+  ExtStatement(ExtStmtType t)
+      : type(t),
+        schema(nullptr),
+        name(nullptr),
+        analyze(false),
+        stmt(nullptr),
+        bound(0) {}
+  ~ExtStatement() {
+    free(schema);
+    free(name);
+  }
+
+  ExtStmtType type;
+  char* schema;
+  char* name;
+  bool analyze;           // EXPLAIN ANALYZE
+  BoundStatement* stmt;   // statement explained, owned by the parser
+  std::string partition;  // ALTER TABLE ADD or DROP PARTITION
+  int64_t bound;          // ADD PARTITION
+};
+
 class Parser {
  public:
   Parser();
@@ -16,38 +118,72 @@ class Parser {
   bool parseStatement(std::string query);
 
   SQLParserResult* getResult() { return result_; }
+  /* One for each statement of the result. */
+  std::vector<BoundStatement*>& getBoundStatements() { return bound_; }
+  ExtStatement* getExtStatement() { return extStmt_; }
 
  private:
+  bool parseSQLStatement(std::string& query);
+
+  bool parseExtStatement(std::vector<std::string>& tokens);
+
+  bool parseExplainStatement(std::string& query,
+                             std::vector<std::string>& tokens);
+
+  bool parseAlterPartition(std::vector<std::string>& tokens);
+
+  bool parsePartitionedCreate(std::string& query,
+                              std::vector<std::string>& tokens,
+                              std::vector<size_t>& offsets, size_t pos);
+
+  bool parseTableName(std::vector<std::string>& tokens, size_t& pos,
+                      ExtStatement* stmt);
+
   bool checkStmtsMeta();
 
-  bool checkMeta(const SQLStatement* stmt);
+  bool checkMeta(BoundStatement* bound);
 
-  bool checkSelectStmt(const SelectStatement* stmt);
+  bool checkSelectStmt(const SelectStatement* stmt, BoundStatement* bound,
+                       BoundStatement* outer = nullptr);
 
-  bool checkInsertStmt(const InsertStatement* stmt);
+  bool checkSetOperations(const SelectStatement* stmt, BoundStatement* bound);
+  bool checkLimit(const LimitDescription* limit);
 
-  bool checkUpdateStmt(const UpdateStatement* stmt);
+  bool checkInsertStmt(const InsertStatement* stmt, BoundStatement* bound);
 
-  bool checkDeleteStmt(const DeleteStatement* stmt);
+  bool checkUpdateStmt(const UpdateStatement* stmt, BoundStatement* bound);
+
+  bool checkDeleteStmt(const DeleteStatement* stmt, BoundStatement* bound);
 
   bool checkCreateStmt(const CreateStatement* stmt);
 
   bool checkDropStmt(const DropStatement* stmt);
 
+  bool checkPrepareStmt(const PrepareStatement* stmt);
+
+  bool checkExecuteStmt(const ExecuteStatement* stmt);
+
   bool checkCreateIndexStmt(const CreateStatement* stmt);
 
   bool checkCreateTableStmt(const CreateStatement* stmt);
 
   Table* getTable(TableRef* table_ref);
 
-  bool checkColumn(Table* table, char* col_name);
+  bool checkColumn(Table* table, char* col_name, size_t* col_id = nullptr);
 
   bool checkExpr(Table* table, Expr* expr);
 
-  bool checkValues(std::vector<ColumnDefinition*>* columns,
-                   std::vector<Expr*>* values);
+  bool checkWhere(Table* table, Expr* where, BoundStatement* bound,
+                  BoundStatement* outer = nullptr);
+
+  bool checkSubquery(Table* table, Expr* where, BoundStatement* bound);
+
+  bool checkCorrelation(Expr* where, BoundStatement* bound,
+                        BoundStatement* outer, bool* correlated);
 
   SQLParserResult* result_;
+  std::vector<BoundStatement*> bound_;
+  ExtStatement* extStmt_;
 };
 
 }  // namespace bydb
\ No newline at end of file
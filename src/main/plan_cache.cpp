@@ -0,0 +1,266 @@
+#include "plan_cache.h"
+#include "metadata.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace bydb {
+
+PlanCache g_plan_cache;
+
+PlanCache::~PlanCache() {
+  for (auto& iter : plans_) {
+    delete iter.second.cached;
+  }
+  for (auto& iter : prepared_) {
+    delete iter.second;
+  }
+}
+
+static bool IsIdentChar(char c) { return isalnum(c) || c == '_'; }
+
+bool PlanCache::normalize(const std::string& query, std::string* key,
+                          std::vector<Expr*>* params, Arena* arena) {
+  enum TokenType { kNone, kWord, kValue, kSymbol };
+  TokenType last = kNone;
+  bool space = false;
+  size_t len = query.length();
+  size_t i = 0;
+
+  while (i < len) {
+    char c = query[i];
+    if (isspace(c)) {
+      space = true;
+      i++;
+      continue;
+    }
+    if (space && !key->empty()) {
+      key->push_back(' ');
+    }
+    space = false;
+
+    if (isalpha(c) || c == '_') {
+      size_t start = i;
+      while (i < len && IsIdentChar(query[i])) {
+        i++;
+      }
+      key->append(query, start, i - start);
+      last = kWord;
+      continue;
+    }
+
+    /* A '-' right after an operator, a comma or '(' is the sign of the
+    number following it. */
+    bool negative = (c == '-' && i + 1 < len && isdigit(query[i + 1]) &&
+                     (last == kNone || last == kSymbol));
+    if (isdigit(c) || negative) {
+      size_t start = i;
+      bool is_float = false;
+      i++;
+      while (i < len && (isdigit(query[i]) || query[i] == '.')) {
+        is_float |= (query[i] == '.');
+        i++;
+      }
+      if (i < len && IsIdentChar(query[i])) {
+        return false;
+      }
+
+      std::string num = query.substr(start, i - start);
+      Expr* param = nullptr;
+      if (is_float) {
+        param = arena->alloc<Expr>(kExprLiteralFloat);
+        param->fval = strtod(num.c_str(), nullptr);
+      } else {
+        param = arena->alloc<Expr>(kExprLiteralInt);
+        param->ival = strtoll(num.c_str(), nullptr, 10);
+      }
+      params->push_back(param);
+      key->push_back('?');
+      last = kValue;
+      continue;
+    }
+
+    if (c == '\'') {
+      std::string str;
+      i++;
+      while (true) {
+        if (i >= len) {
+          return false;
+        }
+        if (query[i] == '\'') {
+          if (i + 1 < len && query[i + 1] == '\'') {
+            str.push_back('\'');
+            i += 2;
+            continue;
+          }
+          i++;
+          break;
+        }
+        str.push_back(query[i++]);
+      }
+
+      Expr* param = arena->alloc<Expr>(kExprLiteralString);
+      param->name = arena->strdup(str.c_str(), str.length());
+      params->push_back(param);
+      key->push_back('?');
+      last = kValue;
+      continue;
+    }
+
+    if (c == '"') {
+      size_t end = query.find('"', i + 1);
+      if (end == std::string::npos) {
+        return false;
+      }
+      key->append(query, i, end + 1 - i);
+      i = end + 1;
+      last = kWord;
+      continue;
+    }
+
+    /* Several statements in one line, or placeholders given by the user,
+    are left to the normal path. */
+    if (c == '?') {
+      return false;
+    }
+    if (c == ';') {
+      if (query.find_first_not_of(" \t\r\n;", i) != std::string::npos) {
+        return false;
+      }
+      break;
+    }
+
+    key->push_back(c);
+    last = (c == ')') ? kValue : kSymbol;
+    i++;
+  }
+
+  /* Only DML is cached, DDL and transaction control are cheap to plan and
+  may carry literals which can not be parameters. */
+  size_t end = key->find(' ');
+  std::string first = key->substr(0, end);
+  for (auto& ch : first) {
+    ch = tolower(ch);
+  }
+  return (first == "select" || first == "insert" || first == "update" ||
+          first == "delete");
+}
+
+CachedPlan* PlanCache::getPlan(const std::string& key) {
+  auto iter = plans_.find(key);
+  if (iter != plans_.end()) {
+    Entry& entry = iter->second;
+    if (entry.cached->version == g_meta_data.version()) {
+      lru_.splice(lru_.begin(), lru_, entry.lru);
+      return entry.cached;
+    }
+    erase(key);
+  }
+
+  /* The caller plans the query from its own text when this fails, and that
+  reports the errors, so what building the normalized one prints is
+  dropped. */
+  std::ostringstream discarded;
+  std::streambuf* out = std::cout.rdbuf(discarded.rdbuf());
+  CachedPlan* cached = buildPlan(key);
+  std::cout.rdbuf(out);
+  if (cached == nullptr) {
+    return nullptr;
+  }
+
+  if (plans_.size() >= PLAN_CACHE_SIZE) {
+    std::string victim = lru_.back();
+    erase(victim);
+  }
+  lru_.push_front(key);
+  plans_[key] = {cached, lru_.begin()};
+  return cached;
+}
+
+bool PlanCache::prepare(const std::string& name, const std::string& query) {
+  CachedPlan* cached = buildPlan(query);
+  if (cached == nullptr) {
+    return true;
+  }
+
+  deallocate(name);
+  prepared_[name] = cached;
+  return false;
+}
+
+CachedPlan* PlanCache::findPrepared(const std::string& name) {
+  auto iter = prepared_.find(name);
+  return (iter == prepared_.end()) ? nullptr : iter->second;
+}
+
+CachedPlan* PlanCache::getPrepared(const std::string& name) {
+  auto iter = prepared_.find(name);
+  if (iter == prepared_.end()) {
+    return nullptr;
+  }
+
+  if (iter->second->version != g_meta_data.version()) {
+    CachedPlan* cached = buildPlan(iter->second->query);
+    if (cached == nullptr) {
+      return nullptr;
+    }
+    delete iter->second;
+    iter->second = cached;
+  }
+
+  return iter->second;
+}
+
+bool PlanCache::deallocate(const std::string& name) {
+  auto iter = prepared_.find(name);
+  if (iter == prepared_.end()) {
+    return true;
+  }
+
+  delete iter->second;
+  prepared_.erase(iter);
+  return false;
+}
+
+CachedPlan* PlanCache::buildPlan(const std::string& key) {
+  CachedPlan* cached = new CachedPlan();
+  cached->query = key;
+  cached->version = g_meta_data.version();
+
+  if (cached->parser.parseStatement(key)) {
+    delete cached;
+    return nullptr;
+  }
+
+  SQLParserResult* result = cached->parser.getResult();
+  if (result == nullptr || result->size() != 1) {
+    delete cached;
+    return nullptr;
+  }
+
+  Optimizer optimizer(&cached->arena);
+  cached->plan =
+      optimizer.createPlanTree(cached->parser.getBoundStatements()[0]);
+  cached->paramNum = result->parameters().size();
+  if (cached->plan == nullptr) {
+    delete cached;
+    return nullptr;
+  }
+
+  return cached;
+}
+
+void PlanCache::erase(const std::string& key) {
+  auto iter = plans_.find(key);
+  if (iter == plans_.end()) {
+    return;
+  }
+
+  delete iter->second.cached;
+  lru_.erase(iter->second.lru);
+  plans_.erase(iter);
+}
+
+}  // namespace bydb
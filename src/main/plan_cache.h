@@ -0,0 +1,71 @@
+#pragma once
+
+#include "arena.h"
+#include "optimizer.h"
+#include "parser.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bydb {
+
+#define PLAN_CACHE_SIZE 1024
+
+/* A plan built from a normalized query, where every literal was replaced by
+a '?' parameter. It keeps the parsed statement alive since the plan points
+into it. */
+struct CachedPlan {
+  CachedPlan() : plan(nullptr), version(0), paramNum(0) {}
+
+  std::string query;
+  Parser parser;
+  Arena arena;
+  Plan* plan;
+  uint64_t version;  // catalog version the plan was built under
+  size_t paramNum;
+};
+
+class PlanCache {
+ public:
+  PlanCache() {}
+  ~PlanCache();
+
+  /* Split a DML query into its normalized text and the values of its
+  literals. Returns false if the query can not go through the cache. */
+  static bool normalize(const std::string& query, std::string* key,
+                        std::vector<Expr*>* params, Arena* arena);
+
+  /* Get the plan of a normalized query, building it on a miss or when the
+  catalog changed since it was built. Returns nullptr, silently, when the
+  normalized query can not be planned. */
+  CachedPlan* getPlan(const std::string& key);
+
+  /* Prepared statements share the cached plan but are named by the user and
+  never evicted. Metadata checking and planning happen at PREPARE, EXECUTE
+  only binds the parameters, unless DDL made the plan stale meanwhile. */
+  bool prepare(const std::string& name, const std::string& query);
+  CachedPlan* findPrepared(const std::string& name);
+  CachedPlan* getPrepared(const std::string& name);
+  bool deallocate(const std::string& name);
+
+ private:
+  typedef std::list<std::string> LruList;
+
+  struct Entry {
+    CachedPlan* cached;
+    LruList::iterator lru;
+  };
+
+  CachedPlan* buildPlan(const std::string& key);
+  void erase(const std::string& key);
+
+  std::unordered_map<std::string, Entry> plans_;
+  LruList lru_;  // most recently used first
+  std::unordered_map<std::string, CachedPlan*> prepared_;
+};
+
+extern PlanCache g_plan_cache;
+
+}  // namespace bydb
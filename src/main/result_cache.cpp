@@ -0,0 +1,184 @@
+#include "result_cache.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bydb {
+
+ResultCache g_result_cache;
+
+ResultCache::~ResultCache() {
+  for (auto& iter : results_) {
+    delete iter.second.result;
+  }
+}
+
+/* The query followed by the type and bytes of every value bound to it.
+Returns false for values a key can not be made of. */
+static bool MakeKey(const std::string& query, std::vector<Expr*>* params,
+                    std::string* key) {
+  *key = query;
+  key->push_back('\0');
+  if (params == nullptr) {
+    return true;
+  }
+
+  for (auto param : *params) {
+    if (param->type == kExprLiteralInt) {
+      key->push_back('i');
+      key->append(reinterpret_cast<const char*>(&param->ival),
+                  sizeof(int64_t));
+    } else if (param->type == kExprLiteralFloat) {
+      key->push_back('f');
+      key->append(reinterpret_cast<const char*>(&param->fval),
+                  sizeof(double));
+    } else if (param->type == kExprLiteralString) {
+      uint32_t len = strlen(param->name);
+      key->push_back('s');
+      key->append(reinterpret_cast<const char*>(&len), sizeof(uint32_t));
+      key->append(param->name, len);
+    } else if (param->type == kExprLiteralNull) {
+      key->push_back('n');
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* The tables a plan reads, those of its subqueries and set operations
+included. */
+static void ScannedTables(Plan* plan, std::vector<Table*>* tables) {
+  for (; plan != nullptr; plan = plan->next) {
+    Plan* right = nullptr;
+    if (plan->planType == kScan) {
+      Table* table = static_cast<ScanPlan*>(plan)->table;
+      if (std::find(tables->begin(), tables->end(), table) == tables->end()) {
+        tables->push_back(table);
+      }
+    } else if (plan->planType == kSetOp) {
+      right = static_cast<SetOpPlan*>(plan)->right;
+    } else if (plan->planType == kSemiJoin) {
+      right = static_cast<SemiJoinPlan*>(plan)->right;
+    }
+    if (right != nullptr) {
+      ScannedTables(right, tables);
+    }
+  }
+}
+
+/* Every partition counts, the ones a filter pruned included. TRUNCATE and
+partition DDL swap stores, but they bump the catalog version as well. */
+static void ModCounts(const std::vector<Table*>& tables,
+                      std::vector<std::pair<TableStore*, uint64_t>>* stores) {
+  for (auto table : tables) {
+    for (auto partition : *table->partitions()) {
+      TableStore* table_store = partition->getTableStore();
+      stores->emplace_back(table_store, table_store->modCount());
+    }
+  }
+}
+
+bool ResultCache::run(const std::string& query, Plan* plan,
+                      std::vector<Expr*>* params, Arena* arena) {
+  std::string key;
+  bool cacheable =
+      enabled() && plan->planType == kSelect && MakeKey(query, params, &key);
+  if (cacheable && print(key, arena)) {
+    hits_++;
+    return false;
+  }
+
+  Executor executor(plan, arena, params);
+  if (cacheable) {
+    misses_++;
+    executor.cacheResult(&key);
+  }
+  executor.init();
+  return executor.exec();
+}
+
+/* Results bigger than the whole cache are not kept. */
+void ResultCache::insert(const std::string& key, SelectPlan* plan,
+                         TupleIterList& tuples, Arena* arena) {
+  CachedResult* result = new CachedResult();
+  result->version = g_meta_data.version();
+  ScannedTables(plan, &result->tables);
+  ModCounts(result->tables, &result->stores);
+  result->columns = plan->outCols;
+  /* The key is held by the map and by the LRU list. */
+  result->bytes = sizeof(CachedResult) + key.size() * 2 +
+                  result->tables.size() * sizeof(Table*) +
+                  result->stores.size() * sizeof(result->stores[0]) +
+                  result->columns.size() * sizeof(ColumnDefinition*);
+
+  TupleIter* row = arena->alloc<TupleIter>(nullptr, nullptr, arena);
+  for (auto tup : tuples) {
+    row->values.clear();
+    for (auto col_id : plan->colIds) {
+      row->values.push_back(tup->values[col_id]);
+    }
+    std::string encoded;
+    EncodeRow(row, &encoded);
+    result->bytes += encoded.size() + RESULT_ROW_OVERHEAD;
+    if (result->bytes > capacity_) {
+      delete result;
+      return;
+    }
+    result->rows.push_back(std::move(encoded));
+  }
+
+  erase(key);
+  while (bytes_ + result->bytes > capacity_) {
+    erase(lru_.back());
+  }
+  lru_.push_front(key);
+  results_[key] = {result, lru_.begin()};
+  bytes_ += result->bytes;
+}
+
+bool ResultCache::print(const std::string& key, Arena* arena) {
+  auto iter = results_.find(key);
+  if (iter == results_.end()) {
+    return false;
+  }
+
+  CachedResult* result = iter->second.result;
+  bool valid = (result->version == g_meta_data.version());
+  if (valid) {
+    std::vector<std::pair<TableStore*, uint64_t>> stores;
+    ModCounts(result->tables, &stores);
+    valid = (stores == result->stores);
+  }
+  if (!valid) {
+    erase(key);
+    return false;
+  }
+
+  lru_.splice(lru_.begin(), lru_, iter->second.lru);
+  TupleIterList tuples(arena);
+  for (auto& row : result->rows) {
+    tuples.push_back(DecodeRow(row, arena));
+  }
+  std::vector<size_t> col_ids;
+  for (size_t i = 0; i < result->columns.size(); i++) {
+    col_ids.push_back(i);
+  }
+  PrintTuples(result->columns, col_ids, tuples);
+  return true;
+}
+
+void ResultCache::erase(const std::string& key) {
+  auto iter = results_.find(key);
+  if (iter == results_.end()) {
+    return;
+  }
+
+  bytes_ -= iter->second.result->bytes;
+  delete iter->second.result;
+  lru_.erase(iter->second.lru);
+  results_.erase(iter);
+}
+
+}  // namespace bydb
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "arena.h"
+#include "executor.h"
+#include "metadata.h"
+#include "optimizer.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bydb {
+
+/* Bytes a cached row takes besides its encoded values. */
+#define RESULT_ROW_OVERHEAD 32
+
+/* The rows a select printed, encoded by EncodeRow() with the select list
+only. They stay valid while the catalog and the rows of every table the
+select read are unchanged. */
+struct CachedResult {
+  CachedResult() : version(0), bytes(0) {}
+
+  uint64_t version;  // catalog version the rows were read under
+  std::vector<Table*> tables;
+  /* The modification count of every partition of the tables. */
+  std::vector<std::pair<TableStore*, uint64_t>> stores;
+  std::vector<ColumnDefinition*> columns;
+  std::vector<std::string> rows;
+  size_t bytes;
+};
+
+/* Results of read-only queries run from a cached or prepared plan, keyed
+by the plan's query and the values bound to it. Results are only looked up
+when they were used, stale ones are dropped then. The least recently used
+ones are evicted to stay under the capacity. */
+class ResultCache {
+ public:
+  ResultCache() : capacity_(0), bytes_(0), hits_(0), misses_(0) {}
+  ~ResultCache();
+
+  /* 0, the default, disables the cache. */
+  void setCapacity(size_t bytes) { capacity_ = bytes; }
+  bool enabled() { return capacity_ > 0; }
+
+  /* Runs the plan of 'query' with 'params' bound to it, or prints what its
+  last run printed. */
+  bool run(const std::string& query, Plan* plan, std::vector<Expr*>* params,
+           Arena* arena);
+
+  /* Called by the select of a plan run with a key, with the rows it is
+  about to print. */
+  void insert(const std::string& key, SelectPlan* plan, TupleIterList& tuples,
+              Arena* arena);
+
+  uint64_t hits() { return hits_; }
+  uint64_t misses() { return misses_; }
+
+ private:
+  typedef std::list<std::string> LruList;
+
+  struct Entry {
+    CachedResult* result;
+    LruList::iterator lru;
+  };
+
+  bool print(const std::string& key, Arena* arena);
+  void erase(const std::string& key);
+
+  size_t capacity_;
+  size_t bytes_;
+  uint64_t hits_;
+  uint64_t misses_;
+  std::unordered_map<std::string, Entry> results_;
+  LruList lru_;  // most recently used first
+};
+
+extern ResultCache g_result_cache;
+
+}  // namespace bydb
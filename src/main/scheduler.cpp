@@ -0,0 +1,162 @@
+#include "scheduler.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <iostream>
+
+namespace bydb {
+
+TaskScheduler g_scheduler;
+
+/* Index of the worker's own deque, -1 for threads outside the pool. */
+static thread_local int t_worker_id = -1;
+
+TaskScheduler::TaskScheduler() : nextQueue_(0), queued_(0), stop_(false) {}
+
+TaskScheduler::~TaskScheduler() { stop(); }
+
+void TaskScheduler::start(size_t thread_num, bool pin_threads) {
+  if (!threads_.empty()) {
+    return;
+  }
+
+  if (thread_num == 0) {
+    thread_num = std::thread::hardware_concurrency();
+    thread_num = (thread_num == 0) ? 1 : thread_num;
+  }
+
+  stop_ = false;
+  for (size_t i = 0; i < thread_num; i++) {
+    queues_.push_back(new WorkQueue());
+  }
+  for (size_t i = 0; i < thread_num; i++) {
+    threads_.emplace_back(&TaskScheduler::workerLoop, this, i, pin_threads);
+  }
+}
+
+void TaskScheduler::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+
+  for (auto queue : queues_) {
+    delete queue;
+  }
+  queues_.clear();
+}
+
+void TaskScheduler::submit(Task task, TaskGroup* group) {
+  if (group != nullptr) {
+    group->pending_++;
+    Task inner = std::move(task);
+    task = [inner, group]() {
+      inner();
+      group->pending_--;
+    };
+  }
+
+  /* Without workers the submitter runs the task itself, so callers never
+  need a special serial path. */
+  if (queues_.empty()) {
+    task();
+    return;
+  }
+
+  size_t id = (t_worker_id >= 0) ? t_worker_id
+                                 : nextQueue_++ % queues_.size();
+  {
+    std::lock_guard<std::mutex> lock(queues_[id]->mutex);
+    queues_[id]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued_++;
+  }
+  cond_.notify_one();
+}
+
+void TaskScheduler::wait(TaskGroup* group) {
+  waitUntil([group]() { return group->done(); });
+}
+
+void TaskScheduler::waitUntil(const std::function<bool()>& done) {
+  /* The waiting thread helps out instead of blocking, which also keeps
+  nested waits from workers deadlock free. */
+  while (!done()) {
+    Task task;
+    if (popTask(t_worker_id, task)) {
+      task();
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+bool TaskScheduler::popTask(int id, Task& task) {
+  /* Own deque first, newest task on top for cache locality. */
+  if (id >= 0) {
+    WorkQueue* queue = queues_[id];
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (!queue->tasks.empty()) {
+      task = std::move(queue->tasks.back());
+      queue->tasks.pop_back();
+      queued_--;
+      return true;
+    }
+  }
+
+  /* Steal the oldest task from another worker. */
+  size_t queue_num = queues_.size();
+  size_t start = (id >= 0) ? id + 1 : nextQueue_.load();
+  for (size_t i = 0; i < queue_num; i++) {
+    WorkQueue* queue = queues_[(start + i) % queue_num];
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (!queue->tasks.empty()) {
+      task = std::move(queue->tasks.front());
+      queue->tasks.pop_front();
+      queued_--;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void TaskScheduler::workerLoop(size_t id, bool pin_thread) {
+  t_worker_id = id;
+
+#ifdef __linux__
+  if (pin_thread) {
+    size_t cpu_num = std::thread::hardware_concurrency();
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET((cpu_num == 0) ? 0 : id % cpu_num, &cpu_set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set)) {
+      std::cout << "[BYDB-Error]  Failed to pin worker " << id << std::endl;
+    }
+  }
+#endif
+
+  while (true) {
+    Task task;
+    if (popTask(id, task)) {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+    if (stop_) {
+      break;
+    }
+  }
+}
+
+}  // namespace bydb
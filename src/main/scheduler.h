@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bydb {
+
+typedef std::function<void()> Task;
+
+/* Tracks a batch of tasks so the submitter can wait for all of them. */
+class TaskGroup {
+ public:
+  TaskGroup() : pending_(0) {}
+  bool done() { return pending_.load() == 0; }
+
+ private:
+  friend class TaskScheduler;
+  std::atomic<size_t> pending_;
+};
+
+/* The engine-wide execution runtime. Each worker owns a deque, runs its own
+tasks LIFO and steals from the front of the others' deques when it runs dry.
+Subsystems submit work here instead of spawning their own threads. */
+class TaskScheduler {
+ public:
+  TaskScheduler();
+  ~TaskScheduler();
+
+  void start(size_t thread_num, bool pin_threads);
+  void stop();
+
+  void submit(Task task, TaskGroup* group = nullptr);
+  void wait(TaskGroup* group);
+  void waitUntil(const std::function<bool()>& done);
+
+  size_t threadNum() { return threads_.size(); }
+
+ private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void workerLoop(size_t id, bool pin_thread);
+  bool popTask(int id, Task& task);
+
+  std::vector<WorkQueue*> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> nextQueue_;
+  std::atomic<size_t> queued_;
+  std::atomic<bool> stop_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+extern TaskScheduler g_scheduler;
+
+}  // namespace bydb
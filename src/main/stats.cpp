@@ -0,0 +1,206 @@
+#include "stats.h"
+#include "metadata.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace bydb {
+
+static bool IsStringType(DataType type) {
+  return (type == DataType::CHAR || type == DataType::VARCHAR);
+}
+
+static int CompareValue(bool is_string, const StatsValue& v1,
+                        const StatsValue& v2) {
+  if (is_string) {
+    return v1.sval.compare(v2.sval);
+  }
+  return (v1.ival < v2.ival) ? -1 : (v1.ival > v2.ival) ? 1 : 0;
+}
+
+static void BuildColumnStats(ColumnStats& stats, bool is_string,
+                             std::vector<StatsValue>& sample,
+                             size_t sample_rows, size_t total_rows,
+                             size_t null_cnt) {
+  stats.nullFrac =
+      (total_rows == 0) ? 0 : static_cast<double>(null_cnt) / total_rows;
+  if (sample.empty()) {
+    return;
+  }
+
+  std::sort(sample.begin(), sample.end(),
+            [is_string](const StatsValue& v1, const StatsValue& v2) {
+              return CompareValue(is_string, v1, v2) < 0;
+            });
+  stats.min = sample.front();
+  stats.max = sample.back();
+
+  /* Count distinct values, and those seen only once for the estimator. */
+  double distinct = 0;
+  double singles = 0;
+  size_t i = 0;
+  while (i < sample.size()) {
+    size_t j = i + 1;
+    while (j < sample.size() &&
+           CompareValue(is_string, sample[i], sample[j]) == 0) {
+      j++;
+    }
+    distinct++;
+    singles += (j - i == 1) ? 1 : 0;
+    i = j;
+  }
+
+  /* Scale the sample's NDV up to the table with the Duj1 estimator
+  (Haas & Stokes), exact when the whole table was sampled. */
+  double n = sample.size();
+  double total = total_rows - null_cnt;
+  if (sample_rows >= total_rows) {
+    stats.ndv = distinct;
+  } else {
+    stats.ndv = n * distinct / (n - singles + singles * n / total);
+  }
+
+  size_t bucket_num =
+      (sample.size() < HISTOGRAM_BUCKETS) ? sample.size() : HISTOGRAM_BUCKETS;
+  for (size_t b = 1; b <= bucket_num; b++) {
+    stats.bounds.push_back(sample[b * sample.size() / bucket_num - 1]);
+  }
+}
+
+TableStats* AnalyzeTable(Table* table) {
+  std::vector<ColumnDefinition*>* columns = table->columns();
+  size_t col_num = columns->size();
+
+  TableStats* stats = new TableStats();
+  stats->columns.resize(col_num);
+
+  std::vector<std::vector<StatsValue>> samples(col_num);
+  std::vector<size_t> null_cnts(col_num, 0);
+  std::vector<size_t> sample_rows;  // row number held by each sample slot
+
+  /* Reservoir sampling over the whole table, all partitions. */
+  Arena arena;
+  size_t row = 0;
+  unsigned int seed = 0x5eed;
+  FrozenCursor cursor;
+  for (auto partition : *table->partitions()) {
+    TableStore* table_store = partition->getTableStore();
+    for (Tuple* tup = table_store->seqScan(nullptr); tup != nullptr;
+         tup = table_store->seqScan(tup), row++) {
+      ExprList values(&arena);
+      table_store->parseTuple(tup, values, &arena, &cursor);
+
+      size_t slot = row;
+      if (row >= ANALYZE_SAMPLE_SIZE) {
+        slot = rand_r(&seed) % (row + 1);
+      }
+
+      for (size_t i = 0; i < col_num; i++) {
+        Expr* expr = values[i];
+        if (expr->type == kExprLiteralNull) {
+          null_cnts[i]++;
+        }
+        if (slot >= ANALYZE_SAMPLE_SIZE) {
+          continue;
+        }
+
+        /* Nulls take a slot too, they are dropped from the sample below. */
+        StatsValue val;
+        if (expr->type == kExprLiteralNull) {
+          val.isNull = true;
+        } else if (expr->type == kExprLiteralString) {
+          val.sval = expr->name;
+        } else {
+          val.ival = expr->ival;
+        }
+        if (slot == samples[i].size()) {
+          samples[i].push_back(val);
+        } else {
+          samples[i][slot] = val;
+        }
+      }
+
+      /* Parsed values are not needed once sampled. */
+      if (row % ANALYZE_SAMPLE_SIZE == 0) {
+        arena.reset();
+      }
+    }
+  }
+  stats->rowCount = row;
+
+  for (size_t i = 0; i < col_num; i++) {
+    bool is_string = IsStringType((*columns)[i]->type.data_type);
+    std::vector<StatsValue>& sample = samples[i];
+    size_t sample_num = sample.size();
+    sample.erase(std::remove_if(sample.begin(), sample.end(),
+                                [](const StatsValue& val) {
+                                  return val.isNull;
+                                }),
+                 sample.end());
+    BuildColumnStats(stats->columns[i], is_string, sample, sample_num, row,
+                     null_cnts[i]);
+  }
+
+  return stats;
+}
+
+double EstimateEqualSelectivity(Table* table, size_t col_id, Expr* val) {
+  TableStats* stats = table->stats();
+  if (stats == nullptr || stats->rowCount == 0) {
+    /* Without statistics assume a fairly selective predicate. */
+    return 0.1;
+  }
+
+  ColumnStats& col = stats->columns[col_id];
+  double non_null = 1 - col.nullFrac;
+  double sel = (col.ndv > 0) ? non_null / col.ndv : 0;
+  if (val->type != kExprLiteralInt && val->type != kExprLiteralString) {
+    return sel;
+  }
+
+  bool is_string = (val->type == kExprLiteralString);
+  StatsValue value;
+  if (is_string) {
+    value.sval = val->name;
+  } else {
+    value.ival = val->ival;
+  }
+
+  if (col.bounds.empty() || CompareValue(is_string, value, col.min) < 0 ||
+      CompareValue(is_string, value, col.max) > 0) {
+    return 1.0 / stats->rowCount;
+  }
+
+  /* A value appearing as the bound of several buckets covers them all. */
+  size_t hits = 0;
+  for (auto& bound : col.bounds) {
+    hits += (CompareValue(is_string, value, bound) == 0) ? 1 : 0;
+  }
+  if (hits > 1) {
+    return non_null * hits / col.bounds.size();
+  }
+
+  return sel;
+}
+
+double EstimateDistinctRows(Table* table, const std::vector<size_t>& col_ids,
+                            double rows) {
+  TableStats* stats = table->stats();
+  if (stats == nullptr || stats->rowCount == 0) {
+    return rows;
+  }
+
+  /* NULL is one more value of a column holding any. */
+  double distinct = 1;
+  for (auto col_id : col_ids) {
+    ColumnStats& col = stats->columns[col_id];
+    distinct *= col.ndv + (col.nullFrac > 0 ? 1 : 0);
+    if (distinct >= rows) {
+      return rows;
+    }
+  }
+  return distinct;
+}
+
+}  // namespace bydb
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "sql/statements.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace hsql;
+
+namespace bydb {
+
+class Table;
+
+#define HISTOGRAM_BUCKETS 32
+/* ANALYZE builds histograms and NDV from a sample of at most this many rows,
+row counts and null fractions are always exact. */
+#define ANALYZE_SAMPLE_SIZE 30000
+
+/* A column value as kept in statistics, strings and integers share one
+ordering so the histogram code does not care about the type. */
+struct StatsValue {
+  StatsValue() : isNull(false), ival(0) {}
+  bool isNull;
+  int64_t ival;
+  std::string sval;
+};
+
+struct ColumnStats {
+  ColumnStats() : nullFrac(0), ndv(0) {}
+
+  double nullFrac;
+  double ndv;
+  StatsValue min;
+  StatsValue max;
+  /* Equi-depth histogram: upper bounds of buckets holding the same number of
+  non-null rows each. A value spanning several bounds is a frequent one. */
+  std::vector<StatsValue> bounds;
+};
+
+struct TableStats {
+  TableStats() : rowCount(0) {}
+
+  size_t rowCount;
+  std::vector<ColumnStats> columns;
+};
+
+TableStats* AnalyzeTable(Table* table);
+
+/* Fraction of the rows where column 'col_id' equals 'val'. 'val' may be a
+'?' parameter whose value is not known yet. */
+double EstimateEqualSelectivity(Table* table, size_t col_id, Expr* val);
+
+/* Distinct combinations of columns 'col_ids' among 'rows' rows of 'table',
+assuming the columns are independent. */
+double EstimateDistinctRows(Table* table, const std::vector<size_t>& col_ids,
+                            double rows);
+
+}  // namespace bydb
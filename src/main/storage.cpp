@@ -1,50 +1,205 @@
 #include "storage.h"
+#include "compactor.h"
 #include "trx.h"
 #include "util.h"
 
 #include "sql/ColumnType.h"
 #include "sql/Expr.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace hsql;
 
 namespace bydb {
 
+static bool IsIntType(DataType type) {
+  return (type == DataType::INT || type == DataType::LONG);
+}
+
+static int64_t ReadInt(uchar* ptr, int size) {
+  return (size == sizeof(int32_t)) ? *reinterpret_cast<int32_t*>(ptr)
+                                   : *reinterpret_cast<int64_t*>(ptr);
+}
+
+static void WriteInt(uchar* ptr, int size, int64_t val) {
+  if (size == sizeof(int32_t)) {
+    *reinterpret_cast<int32_t*>(ptr) = static_cast<int32_t>(val);
+  } else {
+    *reinterpret_cast<int64_t*>(ptr) = val;
+  }
+}
+
+/* Dictionary codes sit at packed column offsets, copy them out. */
+static uint32_t ReadCode(const uchar* ptr) {
+  uint32_t code;
+  memcpy(&code, ptr, sizeof(code));
+  return code;
+}
+
+static void WriteCode(uchar* ptr, uint32_t code) {
+  memcpy(ptr, &code, sizeof(code));
+}
+
+static bool DictTooBig(size_t codes, size_t rows) {
+  return codes >= STRING_DICT_MIN_CODES &&
+         codes * STRING_DICT_ROWS_PER_CODE > rows;
+}
+
+static FrozenGroup* FrozenOf(Tuple* tup) {
+  uintptr_t tag = reinterpret_cast<uintptr_t>(tup->prev);
+  return reinterpret_cast<FrozenGroup*>(tag & ~static_cast<uintptr_t>(1));
+}
+
+static void FreeFrozenGroup(FrozenGroup* frozen, size_t row_size) {
+  for (auto seg : frozen->segments) {
+    delete seg;
+  }
+  FreeExtent(frozen->rows, row_size * frozen->count);
+  delete frozen;
+}
+
 TableStore::TableStore(std::vector<ColumnDefinition*>* columns)
-    : colNum_(columns->size()), tupleSize_(0), columns_(columns) {
-  colOffset_.push_back(0);
+    : colNum_(columns->size()),
+      nullBytes_(0),
+      tupleSize_(0),
+      frozenSize_(0),
+      tupleCount_(0),
+      frozenCount_(0),
+      passes_(0),
+      modCount_(0),
+      hasIntColumn_(false),
+      dictsFull_(false),
+      columns_(columns),
+      groupBytes_(TUPLE_GROUP_MIN_BYTES),
+      unusedBegin_(nullptr),
+      unusedEnd_(nullptr),
+      frozenGroups_(nullptr),
+      freeList_(nullptr) {
+  int nullable_num = 0;
+  for (auto col : *columns) {
+    nullBit_.push_back(col->nullable ? nullable_num++ : -1);
+
+    StringDict* dict = nullptr;
+    if (col->type.data_type == DataType::CHAR &&
+        ColumnTypeSize(col->type) > sizeof(uint32_t)) {
+      dict = new StringDict();
+    }
+    dicts_.push_back(dict);
+    if (IsIntType(col->type.data_type)) {
+      hasIntColumn_ = true;
+    }
+  }
+  nullBytes_ = (nullable_num + 7) / 8;
+
+  layout();
+}
+
+/* Offsets of the columns in hot and frozen rows, and the size of both. */
+void TableStore::layout() {
+  tupleSize_ = 0;
+  frozenSize_ = 0;
+  colOffset_.assign(1, 0);
+  frozenOffset_.clear();
 
   // Add space for each columns
-  for (auto col : *columns) {
-    tupleSize_ += ColumnTypeSize(col->type);
+  for (int i = 0; i < colNum_; i++) {
+    ColumnDefinition* col = (*columns_)[i];
+    size_t size = (dicts_[i] != nullptr) ? sizeof(uint32_t)
+                                         : ColumnTypeSize(col->type);
+    tupleSize_ += size;
     colOffset_.push_back(tupleSize_);
+
+    /* Frozen rows leave out the compressed columns. */
+    frozenOffset_.push_back(frozenSize_);
+    if (!IsIntType(col->type.data_type)) {
+      frozenSize_ += size;
+    }
   }
 
-  // Add space for null map
-  tupleSize_ += colNum_;
+  // Add space for null bitmap
+  tupleSize_ += nullBytes_;
+  frozenSize_ += nullBytes_;
 
   // Add space for header
   tupleSize_ += TUPLE_HEADER_SIZE;
+  frozenSize_ += FROZEN_HEADER_SIZE;
+
+  /* Frozen rows are aligned like tuples, their header is read as a Tuple.
+  Extents are page aligned. */
+  tupleSize_ = (tupleSize_ + TUPLE_ALIGN - 1) / TUPLE_ALIGN * TUPLE_ALIGN;
+  frozenSize_ = (frozenSize_ + TUPLE_ALIGN - 1) / TUPLE_ALIGN * TUPLE_ALIGN;
 }
 
 TableStore::~TableStore() {
-  for (auto tuple_group : tupleGroups_) {
-    free(tuple_group);
+  for (auto iter : tupleGroups_) {
+    FreeExtent(iter.second->tuples, iter.second->bytes);
+    delete iter.second;
+  }
+  while (frozenGroups_ != nullptr) {
+    FrozenGroup* frozen = frozenGroups_;
+    frozenGroups_ = frozen->next;
+    FreeFrozenGroup(frozen, frozenSize_);
   }
+  for (auto dict : dicts_) {
+    delete dict;
+  }
+}
+
+StringHeap::~StringHeap() {
+  for (auto block : blocks_) {
+    free(block);
+  }
+}
+
+/* A value never spans two blocks, longer ones get a block of their own. */
+uint64_t StringHeap::append(const char* str, size_t len) {
+  if (used_ + len + 1 > STRING_HEAP_BLOCK_SIZE) {
+    size_t size = std::max<size_t>(len + 1, STRING_HEAP_BLOCK_SIZE);
+    blocks_.push_back(static_cast<char*>(malloc(size)));
+    used_ = 0;
+  }
+
+  uint64_t offset = (static_cast<uint64_t>(blocks_.size() - 1) << 32) | used_;
+  char* ptr = blocks_.back() + used_;
+  memcpy(ptr, str, len);
+  ptr[len] = '\0';
+  used_ += len + 1;
+  return offset;
+}
+
+uint32_t StringDict::encode(const char* str) {
+  auto res = codes_.emplace(str, strs_.size());
+  if (res.second) {
+    strs_.push_back(res.first->first.c_str());
+  }
+  return res.first->second;
+}
+
+bool StringDict::lookup(const char* str, uint32_t* code) {
+  auto iter = codes_.find(str);
+  if (iter == codes_.end()) {
+    return true;
+  }
+
+  *code = iter->second;
+  return false;
 }
 
 bool TableStore::insertTuple(std::vector<Expr*>* values) {
-  if (freeList_.isEmpty()) {
-    if (newTupleGroup()) {
-      return true;
-    }
+  Tuple* tup = allocTuple();
+  if (tup == nullptr) {
+    return true;
   }
 
-  Tuple* tup = freeList_.popHead();
   dataList_.addHead(tup);
+  tupleCount_++;
+  modCount_++;
 
   int idx = 0;
   for (auto expr : *values) {
@@ -61,9 +216,15 @@ bool TableStore::insertTuple(std::vector<Expr*>* values) {
 
 bool TableStore::deleteTuple(Tuple* tup) {
   dataList_.delTuple(tup);
-  freeList_.addHead(tup);
+  tupleCount_--;
+  modCount_++;
+  /* In a transaction the slot is kept until commit so rollback can recover
+  it. */
   if (g_transaction.inTransaction()) {
     g_transaction.addDeleteUndo(this, tup);
+    touch(tup);
+  } else {
+    releaseTuple(tup);
   }
 
   return true;
@@ -71,17 +232,56 @@ bool TableStore::deleteTuple(Tuple* tup) {
 
 void TableStore::removeTuple(Tuple* tup) {
   dataList_.delTuple(tup);
-  freeList_.addHead(tup);
+  releaseTuple(tup);
+  tupleCount_--;
+  modCount_++;
+}
+
+void TableStore::recoverTuple(Tuple* tup) {
+  dataList_.addHead(tup);
+  touch(tup);
+  tupleCount_++;
+  modCount_++;
+}
+
+void TableStore::freeTuple(Tuple* tup) { releaseTuple(tup); }
+
+Tuple* TableStore::allocTuple() {
+  Tuple* tup = freeList_;
+  if (tup != nullptr) {
+    freeList_ = tup->next;
+  } else {
+    if (unusedBegin_ == unusedEnd_ && newTupleGroup()) {
+      return nullptr;
+    }
+    tup = reinterpret_cast<Tuple*>(unusedBegin_);
+    unusedBegin_ += tupleSize_;
+  }
+
+  TupleGroup* group = findGroup(tup);
+  group->live++;
+  group->modified = passes_;
+  return tup;
 }
 
-void TableStore::recoverTuple(Tuple* tup) { dataList_.addHead(tup); }
+void TableStore::releaseTuple(Tuple* tup) {
+  TupleGroup* group = findGroup(tup);
+  group->live--;
+  group->modified = passes_;
+  pushFree(tup);
+}
 
-void TableStore::freeTuple(Tuple* tup) { freeList_.addHead(tup); }
+TupleGroup* TableStore::findGroup(Tuple* tup) {
+  auto iter = tupleGroups_.upper_bound(reinterpret_cast<uchar*>(tup));
+  return (--iter)->second;
+}
 
 bool TableStore::updateTuple(Tuple* tup, std::vector<size_t>& idxs,
                              std::vector<Expr*>& values) {
+  touch(tup);
+  modCount_++;
   if (g_transaction.inTransaction()) {
-    g_transaction.addUpdateUndo(this, tup);
+    g_transaction.addUpdateUndo(this, tup, idxs);
   }
 
   for (size_t i = 0; i < idxs.size(); i++) {
@@ -93,45 +293,213 @@ bool TableStore::updateTuple(Tuple* tup, std::vector<size_t>& idxs,
   return false;
 }
 
+/* The before-image of an update only covers the modified columns, laid out as
+[count][column ids][null flag + value of each column]. */
+uchar* TableStore::saveColumns(Tuple* tup, std::vector<size_t>& idxs) {
+  uchar* nulls = tup->data;
+  uchar* data = tup->data + nullBytes_;
+  uint32_t count = idxs.size();
+
+  size_t image_size = sizeof(uint32_t) * (count + 1);
+  for (auto idx : idxs) {
+    image_size += sizeof(bool) + colOffset_[idx + 1] - colOffset_[idx];
+  }
+
+  uchar* image = static_cast<uchar*>(malloc(image_size));
+  uchar* ptr = image;
+  memcpy(ptr, &count, sizeof(uint32_t));
+  ptr += sizeof(uint32_t);
+  for (auto idx : idxs) {
+    uint32_t col_id = idx;
+    memcpy(ptr, &col_id, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+  }
+
+  for (auto idx : idxs) {
+    int size = colOffset_[idx + 1] - colOffset_[idx];
+    *reinterpret_cast<bool*>(ptr) = isNull(nulls, idx);
+    ptr += sizeof(bool);
+    memcpy(ptr, data + colOffset_[idx], size);
+    ptr += size;
+  }
+
+  return image;
+}
+
+void TableStore::restoreColumns(Tuple* tup, uchar* image) {
+  touch(tup);
+  modCount_++;
+  uchar* nulls = tup->data;
+  uchar* data = tup->data + nullBytes_;
+  uint32_t count = 0;
+  memcpy(&count, image, sizeof(uint32_t));
+
+  uchar* ids = image + sizeof(uint32_t);
+  uchar* ptr = ids + sizeof(uint32_t) * count;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t idx = 0;
+    memcpy(&idx, ids + sizeof(uint32_t) * i, sizeof(uint32_t));
+    int size = colOffset_[idx + 1] - colOffset_[idx];
+    setNull(nulls, idx, *reinterpret_cast<bool*>(ptr));
+    ptr += sizeof(bool);
+    memcpy(data + colOffset_[idx], ptr, size);
+    ptr += size;
+  }
+}
+
+/* Frozen groups are scanned after the hot tuples. */
 Tuple* TableStore::seqScan(Tuple* tup) {
+  Tuple* next = nullptr;
   if (tup == nullptr) {
-    return dataList_.getHead();
+    next = dataList_.getHead();
+  } else if (!IsFrozen(tup)) {
+    next = dataList_.getNext(tup);
   } else {
-    return dataList_.getNext(tup);
+    FrozenGroup* frozen = FrozenOf(tup);
+    size_t row = (reinterpret_cast<uchar*>(tup) - frozen->rows) / frozenSize_;
+    if (row + 1 < frozen->count) {
+      return frozenRow(frozen, row + 1);
+    }
+    return (frozen->next == nullptr) ? nullptr : frozenRow(frozen->next, 0);
+  }
+
+  if (next == nullptr && frozenGroups_ != nullptr) {
+    next = frozenRow(frozenGroups_, 0);
+  }
+  return next;
+}
+
+void TableStore::slotRanges(size_t size, std::vector<SlotRange>* ranges) {
+  for (auto iter : tupleGroups_) {
+    TupleGroup* group = iter.second;
+    uchar* begin = reinterpret_cast<uchar*>(group->tuples);
+    uchar* end = begin + group->capacity * tupleSize_;
+    if (unusedBegin_ >= begin && unusedBegin_ < end) {
+      end = unusedBegin_;
+    }
+    size_t slots = (end - begin) / tupleSize_;
+    for (size_t i = 0; i < slots; i += size) {
+      ranges->push_back({begin + i * tupleSize_, std::min(size, slots - i),
+                         false});
+    }
+  }
+  for (FrozenGroup* frozen = frozenGroups_; frozen != nullptr;
+       frozen = frozen->next) {
+    for (size_t i = 0; i < frozen->count; i += size) {
+      ranges->push_back({frozen->rows + i * frozenSize_,
+                         std::min(size, frozen->count - i), true});
+    }
   }
 }
 
-void TableStore::parseTuple(Tuple* tup, std::vector<Expr*>& values) {
-  bool* is_null = reinterpret_cast<bool*>(&tup->data[0]);
-  uchar* data = tup->data + columns_->size();
+/* Free slots, slots never handed out, which come zeroed, and tuples deleted
+by the open transaction have a null 'prev'. */
+Tuple* TableStore::rangeScan(const SlotRange& range, Tuple* tup) {
+  size_t size = range.frozen ? frozenSize_ : tupleSize_;
+  uchar* end = range.begin + range.count * size;
+  uchar* ptr = range.begin;
+  if (tup != nullptr) {
+    ptr = reinterpret_cast<uchar*>(tup) + size;
+  }
+  for (; ptr < end; ptr += size) {
+    Tuple* next = reinterpret_cast<Tuple*>(ptr);
+    if (range.frozen || next->prev != nullptr) {
+      return next;
+    }
+  }
+  return nullptr;
+}
+
+void TableStore::locate(Tuple* tup, uchar** nulls, uchar** data,
+                        const int** offsets) {
+  if (IsFrozen(tup)) {
+    uchar* row = reinterpret_cast<uchar*>(tup) + FROZEN_HEADER_SIZE;
+    *nulls = row;
+    *data = row + nullBytes_;
+    *offsets = frozenOffset_.data();
+  } else {
+    *nulls = tup->data;
+    *data = tup->data + nullBytes_;
+    *offsets = colOffset_.data();
+  }
+}
+
+void TableStore::setNull(uchar* nulls, size_t idx, bool is_null) {
+  int bit = nullBit_[idx];
+  if (bit < 0) {
+    return;
+  }
+  if (is_null) {
+    nulls[bit / 8] |= (1 << (bit % 8));
+  } else {
+    nulls[bit / 8] &= ~(1 << (bit % 8));
+  }
+}
+
+void TableStore::parseTuple(Tuple* tup, ExprList& values, Arena* arena,
+                            FrozenCursor* cursor) {
+  uchar* nulls = nullptr;
+  uchar* data = nullptr;
+  const int* offsets = nullptr;
+  locate(tup, &nulls, &data, &offsets);
+
+  FrozenGroup* frozen = IsFrozen(tup) ? FrozenOf(tup) : nullptr;
+  size_t row = 0;
+  if (frozen != nullptr) {
+    row = (reinterpret_cast<uchar*>(tup) - frozen->rows) / frozenSize_;
+  }
 
   for (size_t i = 0; i < columns_->size(); i++) {
     Expr* e = nullptr;
-    if (is_null[i]) {
-      e = Expr::makeNullLiteral();
+    if (isNull(nulls, i)) {
+      e = arena->alloc<Expr>(kExprLiteralNull);
+      values.push_back(e);
+      continue;
+    }
+
+    if (frozen != nullptr && frozen->segments[i] != nullptr) {
+      e = arena->alloc<Expr>(kExprLiteralInt);
+      e->ival = frozenValue(frozen, row, i, cursor);
       values.push_back(e);
       continue;
     }
 
     ColumnDefinition* col = (*columns_)[i];
-    int offset = colOffset_[i];
+    int offset = offsets[i];
     int size = colOffset_[i + 1] - colOffset_[i];
     switch (col->type.data_type) {
       case DataType::INT: {
-        int64_t val = *reinterpret_cast<int32_t*>(data + offset);
-        e = Expr::makeLiteral(val);
+        e = arena->alloc<Expr>(kExprLiteralInt);
+        e->ival = *reinterpret_cast<int32_t*>(data + offset);
         break;
       }
       case DataType::LONG: {
-        int64_t val = *reinterpret_cast<int64_t*>(data + offset);
-        e = Expr::makeLiteral(val);
+        e = arena->alloc<Expr>(kExprLiteralInt);
+        e->ival = *reinterpret_cast<int64_t*>(data + offset);
         break;
       }
       case DataType::CHAR:
       case DataType::VARCHAR: {
-        char* val = static_cast<char*>(malloc(size));
-        memcpy(val, (data + offset), size);
-        e = Expr::makeLiteral(val);
+        e = arena->alloc<Expr>(kExprLiteralString);
+        /* Encoded strings are not copied, the value points into the
+        dictionary, which lives as long as the table. */
+        if (dicts_[i] != nullptr) {
+          const char* str = dicts_[i]->decode(ReadCode(data + offset));
+          e->name = const_cast<char*>(str);
+          break;
+        }
+        if (col->type.data_type == DataType::VARCHAR) {
+          VarString str;
+          memcpy(&str, data + offset, sizeof(VarString));
+          if (str.isInline()) {
+            e->name = arena->strdup(str.prefix, str.len);
+          } else {
+            e->name = const_cast<char*>(heap_.get(str.offset));
+          }
+          break;
+        }
+        e->name = static_cast<char*>(arena->allocate(size, 1));
+        memcpy(e->name, (data + offset), size);
         break;
       }
       default:
@@ -141,34 +509,494 @@ void TableStore::parseTuple(Tuple* tup, std::vector<Expr*>& values) {
   }
 }
 
-bool TableStore::newTupleGroup() {
-  Tuple* tuple_group =
-      static_cast<Tuple*>(malloc(tupleSize_ * TUPLE_GROUP_SIZE));
-  memset(tuple_group, 0, (tupleSize_ * TUPLE_GROUP_SIZE));
+bool TableStore::matchCode(Tuple* tup, size_t idx, uint32_t code) {
+  uchar* nulls = nullptr;
+  uchar* data = nullptr;
+  const int* offsets = nullptr;
+  locate(tup, &nulls, &data, &offsets);
+  return !isNull(nulls, idx) && ReadCode(data + offsets[idx]) == code;
+}
+
+bool TableStore::matchChar(Tuple* tup, size_t idx, const char* str) {
+  uchar* nulls = nullptr;
+  uchar* data = nullptr;
+  const int* offsets = nullptr;
+  locate(tup, &nulls, &data, &offsets);
+  return !isNull(nulls, idx) &&
+         strcmp(reinterpret_cast<char*>(data + offsets[idx]), str) == 0;
+}
+
+bool TableStore::matchInt(Tuple* tup, size_t idx, int64_t val,
+                          FrozenCursor* cursor) {
+  uchar* nulls = nullptr;
+  uchar* data = nullptr;
+  const int* offsets = nullptr;
+  locate(tup, &nulls, &data, &offsets);
+  if (isNull(nulls, idx)) {
+    return false;
+  }
+
+  if (IsFrozen(tup)) {
+    FrozenGroup* frozen = FrozenOf(tup);
+    size_t row = (reinterpret_cast<uchar*>(tup) - frozen->rows) / frozenSize_;
+    return frozen->segments[idx]->mayContain(val) &&
+           frozenValue(frozen, row, idx, cursor) == val;
+  }
+  return ReadInt(data + offsets[idx], colOffset_[idx + 1] - colOffset_[idx]) ==
+         val;
+}
+
+int64_t TableStore::frozenValue(FrozenGroup* frozen, size_t row, size_t idx,
+                                FrozenCursor* cursor) {
+  if (cursor == nullptr) {
+    return frozen->segments[idx]->get(row);
+  }
+
+  if (cursor->frozen != frozen) {
+    cursor->frozen = frozen;
+    cursor->cols.resize(colNum_);
+    for (auto& col : cursor->cols) {
+      col.vals.clear();
+    }
+  }
+  FrozenCursor::Column& col = cursor->cols[idx];
+  if (row < col.first || row >= col.first + col.vals.size()) {
+    col.first = row;
+    col.vals.resize(std::min<size_t>(FROZEN_CURSOR_ROWS, frozen->count - row));
+    frozen->segments[idx]->decode(col.vals.data(), row, col.vals.size());
+  }
+  return col.vals[row - col.first];
+}
+
+void TableStore::MakeVarString(const char* str, VarString* key) {
+  memset(key, 0, sizeof(VarString));
+  key->len = strlen(str);
+  if (key->isInline()) {
+    memcpy(key->prefix, str, key->len);
+  } else {
+    memcpy(key->prefix, str, VARSTRING_PREFIX_SIZE);
+  }
+}
+
+bool TableStore::matchVarString(Tuple* tup, size_t idx, VarString* key,
+                                const char* str) {
+  uchar* nulls = nullptr;
+  uchar* data = nullptr;
+  const int* offsets = nullptr;
+  locate(tup, &nulls, &data, &offsets);
+  if (isNull(nulls, idx)) {
+    return false;
+  }
+
+  /* Length and prefix are the first 8 bytes, compared as one word. */
+  const uchar* ptr = data + offsets[idx];
+  if (memcmp(ptr, key, sizeof(uint64_t)) != 0) {
+    return false;
+  }
+  if (key->isInline()) {
+    return memcmp(ptr + offsetof(VarString, rest), key->rest,
+                  sizeof(key->rest)) == 0;
+  }
+  VarString val;
+  memcpy(&val, ptr, sizeof(VarString));
+  return memcmp(heap_.get(val.offset), str, val.len) == 0;
+}
+
+size_t TableStore::freeze() {
+  passes_++;
+  if (!hasIntColumn_) {
+    return 0;
+  }
+
+  size_t frozen_num = 0;
+  auto iter = tupleGroups_.begin();
+  while (iter != tupleGroups_.end()) {
+    TupleGroup* group = iter->second;
+    if (group->live == group->capacity && group->modified + 1 < passes_ &&
+        !freezeGroup(group)) {
+      iter = tupleGroups_.erase(iter);
+      frozen_num++;
+    } else {
+      iter++;
+    }
+  }
+
+  return frozen_num;
+}
+
+bool TableStore::freezeGroup(TupleGroup* group) {
+  FrozenGroup* frozen = new FrozenGroup();
+  frozen->count = group->capacity;
+  frozen->rows =
+      static_cast<uchar*>(AllocExtent(frozenSize_ * frozen->count));
+  if (frozen->rows == nullptr) {
+    delete frozen;
+    return true;
+  }
+  uchar* ptr = reinterpret_cast<uchar*>(group->tuples);
+
+  std::vector<int64_t> vals(frozen->count);
+  for (int i = 0; i < colNum_; i++) {
+    if (!IsIntType((*columns_)[i]->type.data_type)) {
+      frozen->segments.push_back(nullptr);
+      continue;
+    }
+
+    int size = colOffset_[i + 1] - colOffset_[i];
+    for (size_t r = 0; r < frozen->count; r++) {
+      Tuple* tup = reinterpret_cast<Tuple*>(ptr + r * tupleSize_);
+      uchar* col = tup->data + nullBytes_ + colOffset_[i];
+      vals[r] = isNull(tup->data, i) ? 0 : ReadInt(col, size);
+    }
+    frozen->segments.push_back(IntSegment::Encode(vals.data(), frozen->count));
+  }
+
+  uintptr_t tag = reinterpret_cast<uintptr_t>(frozen) | 1;
+  for (size_t r = 0; r < frozen->count; r++) {
+    Tuple* tup = reinterpret_cast<Tuple*>(ptr + r * tupleSize_);
+    uchar* row = frozen->rows + r * frozenSize_;
+    memcpy(row, &tag, sizeof(tag));
+    uchar* data = row + FROZEN_HEADER_SIZE;
+    memcpy(data, tup->data, nullBytes_);
+    for (int i = 0; i < colNum_; i++) {
+      if (frozen->segments[i] == nullptr) {
+        memcpy(data + nullBytes_ + frozenOffset_[i],
+               tup->data + nullBytes_ + colOffset_[i],
+               colOffset_[i + 1] - colOffset_[i]);
+      }
+    }
+    dataList_.delTuple(tup);
+  }
+
+  FreeExtent(group->tuples, group->bytes);
+  delete group;
+
+  frozen->prev = nullptr;
+  frozen->next = frozenGroups_;
+  if (frozenGroups_ != nullptr) {
+    frozenGroups_->prev = frozen;
+  }
+  frozenGroups_ = frozen;
+  frozenCount_++;
+  return false;
+}
+
+bool TableStore::thaw(const std::function<bool(Tuple*)>& match) {
+  FrozenGroup* frozen = frozenGroups_;
+  while (frozen != nullptr) {
+    FrozenGroup* next = frozen->next;
+    bool found = !match;
+    for (size_t r = 0; !found && r < frozen->count; r++) {
+      found = match(frozenRow(frozen, r));
+    }
+    if (found && thawGroup(frozen)) {
+      return true;
+    }
+    frozen = next;
+  }
+
+  return false;
+}
+
+/* Room for all rows is made first, so thawing does not fail half way. */
+bool TableStore::thawGroup(FrozenGroup* frozen) {
+  size_t free_slots = (unusedEnd_ - unusedBegin_) / tupleSize_;
+  for (auto iter : tupleGroups_) {
+    free_slots += iter.second->capacity - iter.second->live;
+  }
+  if (free_slots < frozen->count && newTupleGroup(frozen->count)) {
+    return true;
+  }
+
+  std::vector<Tuple*> tups;
+  for (size_t r = 0; r < frozen->count; r++) {
+    Tuple* tup = allocTuple();
+    uchar* data = reinterpret_cast<uchar*>(frozenRow(frozen, r)) +
+                  FROZEN_HEADER_SIZE;
+    memcpy(tup->data, data, nullBytes_);
+    for (int i = 0; i < colNum_; i++) {
+      if (frozen->segments[i] == nullptr) {
+        memcpy(tup->data + nullBytes_ + colOffset_[i],
+               data + nullBytes_ + frozenOffset_[i],
+               colOffset_[i + 1] - colOffset_[i]);
+      }
+    }
+    dataList_.addHead(tup);
+    tups.push_back(tup);
+  }
+
+  std::vector<int64_t> vals(frozen->count);
+  for (int i = 0; i < colNum_; i++) {
+    if (frozen->segments[i] == nullptr) {
+      continue;
+    }
+    int size = colOffset_[i + 1] - colOffset_[i];
+    frozen->segments[i]->decode(vals.data());
+    for (size_t r = 0; r < frozen->count; r++) {
+      WriteInt(tups[r]->data + nullBytes_ + colOffset_[i], size, vals[r]);
+    }
+  }
+
+  if (frozen->prev != nullptr) {
+    frozen->prev->next = frozen->next;
+  } else {
+    frozenGroups_ = frozen->next;
+  }
+  if (frozen->next != nullptr) {
+    frozen->next->prev = frozen->prev;
+  }
+  FreeFrozenGroup(frozen, frozenSize_);
+  frozenCount_--;
+  return false;
+}
+
+size_t TableStore::compact() {
+  /* The sparsest groups are emptied first, as long as the other groups
+  have room for their tuples. */
+  std::vector<TupleGroup*> sparse;
+  size_t free_slots = 0;
+  for (auto iter : tupleGroups_) {
+    TupleGroup* group = iter.second;
+    free_slots += group->capacity - group->live;
+    if (group->live * COMPACT_SPARSE_RATIO <= group->capacity) {
+      sparse.push_back(group);
+    }
+  }
+  std::sort(sparse.begin(), sparse.end(),
+            [](TupleGroup* a, TupleGroup* b) { return a->live < b->live; });
+
+  std::unordered_set<TupleGroup*> emptied;
+  size_t moving = 0;
+  for (auto group : sparse) {
+    size_t group_free = group->capacity - group->live;
+    if (moving + group->live > free_slots - group_free) {
+      break;
+    }
+    free_slots -= group_free;
+    moving += group->live;
+    emptied.insert(group);
+  }
+  if (emptied.empty()) {
+    return 0;
+  }
+
+  /* Take the free slots of the emptied groups out of the free list, the
+  other slots of these groups hold tuples. So are the slots never handed
+  out if the newest group is emptied. */
+  uchar* unused_begin = unusedEnd_;
+  if (unusedBegin_ != unusedEnd_ &&
+      emptied.count(findGroup(reinterpret_cast<Tuple*>(unusedBegin_))) > 0) {
+    unused_begin = unusedBegin_;
+    unusedBegin_ = unusedEnd_ = nullptr;
+  }
+  std::unordered_set<Tuple*> unused;
+  Tuple** link = &freeList_;
+  while (*link != nullptr) {
+    Tuple* tup = *link;
+    if (emptied.count(findGroup(tup)) > 0) {
+      *link = tup->next;
+      unused.insert(tup);
+    } else {
+      link = &tup->next;
+    }
+  }
+
+  std::unordered_map<Tuple*, Tuple*> moved;
+  for (auto group : emptied) {
+    uchar* ptr = reinterpret_cast<uchar*>(group->tuples);
+    for (size_t i = 0; i < group->capacity; i++, ptr += tupleSize_) {
+      Tuple* old_tup = reinterpret_cast<Tuple*>(ptr);
+      if (ptr == unused_begin) {
+        break;
+      }
+      if (unused.count(old_tup) > 0) {
+        continue;
+      }
+
+      Tuple* new_tup = allocTuple();
+      memcpy(new_tup->data, old_tup->data, tupleSize_ - TUPLE_HEADER_SIZE);
+      /* Tuples deleted in the open transaction are in no list. */
+      if (old_tup->prev != nullptr) {
+        dataList_.replace(old_tup, new_tup);
+      } else {
+        new_tup->prev = nullptr;
+        new_tup->next = nullptr;
+      }
+      moved.emplace(old_tup, new_tup);
+    }
+
+    tupleGroups_.erase(reinterpret_cast<uchar*>(group->tuples));
+    FreeExtent(group->tuples, group->bytes);
+    delete group;
+  }
+
+  if (g_transaction.inTransaction()) {
+    g_transaction.relocate(moved);
+  }
+  return emptied.size();
+}
+
+/* Frozen rows hold codes as well, everything is thawed first. */
+size_t TableStore::checkDicts() {
+  if (!dictsFull_ || thaw(nullptr)) {
+    return 0;
+  }
+  dictsFull_ = false;
+
+  std::vector<bool> inline_cols(colNum_, false);
+  bool relayout = false;
+  size_t changed = 0;
+  for (int i = 0; i < colNum_; i++) {
+    StringDict* dict = dicts_[i];
+    if (dict == nullptr || !DictTooBig(dict->size(), tupleCount_)) {
+      continue;
+    }
+    changed++;
+
+    std::vector<bool> live(dict->size(), false);
+    size_t live_num = 0;
+    for (Tuple* tup = dataList_.getHead(); tup != nullptr;
+         tup = dataList_.getNext(tup)) {
+      uint32_t code = ReadCode(tup->data + nullBytes_ + colOffset_[i]);
+      if (!isNull(tup->data, i) && !live[code]) {
+        live[code] = true;
+        live_num++;
+      }
+    }
+    if (DictTooBig(live_num, tupleCount_)) {
+      inline_cols[i] = true;
+      relayout = true;
+      continue;
+    }
+
+    StringDict* live_dict = new StringDict();
+    std::vector<uint32_t> codes(dict->size());
+    for (uint32_t c = 0; c < dict->size(); c++) {
+      if (live[c]) {
+        codes[c] = live_dict->encode(dict->decode(c));
+      }
+    }
+    for (Tuple* tup = dataList_.getHead(); tup != nullptr;
+         tup = dataList_.getNext(tup)) {
+      uchar* ptr = tup->data + nullBytes_ + colOffset_[i];
+      if (!isNull(tup->data, i)) {
+        WriteCode(ptr, codes[ReadCode(ptr)]);
+      }
+    }
+    delete dict;
+    dicts_[i] = live_dict;
+  }
+
+  if (relayout && storeInline(inline_cols)) {
+    dictsFull_ = true;
+  }
+  return changed;
+}
+
+/* Every tuple is copied into a group of the new layout, which is mapped
+before anything changes so a failure leaves the table as it was. The copies
+are added in reverse scan order, scans see the tuples in the same order. */
+bool TableStore::storeInline(const std::vector<bool>& cols) {
+  std::vector<StringDict*> dicts = dicts_;
+  std::vector<int> col_offset = colOffset_;
+  std::map<uchar*, TupleGroup*> groups;
+  uchar* unused_begin = unusedBegin_;
+  uchar* unused_end = unusedEnd_;
+  TupleList data_list;
+
+  for (int i = 0; i < colNum_; i++) {
+    if (cols[i]) {
+      dicts_[i] = nullptr;
+    }
+  }
+  layout();
+  groups.swap(tupleGroups_);
+  unusedBegin_ = unusedEnd_ = nullptr;
+  if (newTupleGroup(tupleCount_)) {
+    dicts_ = dicts;
+    layout();
+    tupleGroups_.swap(groups);
+    unusedBegin_ = unused_begin;
+    unusedEnd_ = unused_end;
+    return true;
+  }
+  freeList_ = nullptr;
+  dataList_.swap(data_list);
+
+  std::vector<Tuple*> old_tups;
+  for (Tuple* tup = data_list.getHead(); tup != nullptr;
+       tup = data_list.getNext(tup)) {
+    old_tups.push_back(tup);
+  }
+  for (auto iter = old_tups.rbegin(); iter != old_tups.rend(); ++iter) {
+    Tuple* old_tup = *iter;
+    Tuple* tup = allocTuple();
+    memcpy(tup->data, old_tup->data, nullBytes_);
+    for (int i = 0; i < colNum_; i++) {
+      if (isNull(old_tup->data, i)) {
+        continue;
+      }
+      uchar* src = old_tup->data + nullBytes_ + col_offset[i];
+      uchar* dst = tup->data + nullBytes_ + colOffset_[i];
+      if (cols[i]) {
+        const char* str = dicts[i]->decode(ReadCode(src));
+        memcpy(dst, str, strlen(str) + 1);
+      } else {
+        memcpy(dst, src, col_offset[i + 1] - col_offset[i]);
+      }
+    }
+    dataList_.addHead(tup);
+  }
+
+  for (auto iter : groups) {
+    FreeExtent(iter.second->tuples, iter.second->bytes);
+    delete iter.second;
+  }
+  for (int i = 0; i < colNum_; i++) {
+    if (cols[i]) {
+      delete dicts[i];
+    }
+  }
+  return false;
+}
+
+/* Extents come zeroed. Slots of the previous group that were never handed
+out go to the free list, from now on only the new group hands out slots. */
+bool TableStore::newTupleGroup(size_t min_slots) {
+  size_t bytes = ExtentSize(std::max(groupBytes_, min_slots * tupleSize_));
+  Tuple* tuple_group = static_cast<Tuple*>(AllocExtent(bytes));
   if (tuple_group == nullptr) {
-    std::cout << "[BYDB-Error]  Failed to malloc "
-              << tupleSize_ * TUPLE_GROUP_SIZE << " bytes";
+    std::cout << "[BYDB-Error]  Failed to map " << bytes << " bytes."
+              << std::endl;
     return true;
   }
+  groupBytes_ = std::min(groupBytes_ * 2,
+                         static_cast<size_t>(TUPLE_GROUP_MAX_BYTES));
 
-  tupleGroups_.push_back(tuple_group);
-  uchar* ptr = reinterpret_cast<uchar*>(tuple_group);
-  for (int i = 0; i < TUPLE_GROUP_SIZE; i++) {
-    Tuple* tup = reinterpret_cast<Tuple*>(ptr);
-    freeList_.addHead(tup);
-    ptr += tupleSize_;
+  while (unusedBegin_ != unusedEnd_) {
+    pushFree(reinterpret_cast<Tuple*>(unusedBegin_));
+    unusedBegin_ += tupleSize_;
   }
 
+  TupleGroup* group = new TupleGroup();
+  group->tuples = tuple_group;
+  group->bytes = bytes;
+  group->capacity = bytes / tupleSize_;
+  group->live = 0;
+  group->modified = passes_;
+  tupleGroups_.emplace(reinterpret_cast<uchar*>(tuple_group), group);
+  unusedBegin_ = reinterpret_cast<uchar*>(tuple_group);
+  unusedEnd_ = unusedBegin_ + group->capacity * tupleSize_;
+
   return false;
 }
 
 void TableStore::setColValue(Tuple* tup, int idx, Expr* expr) {
-  bool* is_null = reinterpret_cast<bool*>(&tup->data[0]);
-  uchar* data = tup->data + colNum_;
+  uchar* data = tup->data + nullBytes_;
   int offset = colOffset_[idx];
   int size = colOffset_[idx + 1] - colOffset_[idx];
   uchar* ptr = &data[offset];
-  is_null[idx] = false;
+  setNull(tup->data, idx, expr->type == kExprLiteralNull);
 
   switch (expr->type) {
     case kExprLiteralInt: {
@@ -188,14 +1016,30 @@ void TableStore::setColValue(Tuple* tup, int idx, Expr* expr) {
       break;
     }
     case kExprLiteralString: {
+      StringDict* dict = dicts_[idx];
+      if (dict != nullptr) {
+        size_t codes = dict->size();
+        WriteCode(ptr, dict->encode(expr->name));
+        if (dict->size() > codes && DictTooBig(codes + 1, tupleCount_)) {
+          dictsFull_ = true;
+          g_compactor.wake();
+        }
+        break;
+      }
+      if ((*columns_)[idx]->type.data_type == DataType::VARCHAR) {
+        VarString str;
+        MakeVarString(expr->name, &str);
+        if (!str.isInline()) {
+          str.offset = heap_.append(expr->name, str.len);
+        }
+        memcpy(ptr, &str, sizeof(VarString));
+        break;
+      }
       int len = strlen(expr->name);
       memcpy(ptr, expr->name, len);
       ptr[len] = '\0';
       break;
     }
-    case kExprLiteralNull:
-      is_null[idx] = true;
-      break;
     default:
       break;
   }
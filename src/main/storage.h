@@ -1,21 +1,43 @@
 #pragma once
 
+#include "arena.h"
+#include "compress.h"
+#include "extent.h"
+
 #include "sql/statements.h"
 
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <map>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 using namespace hsql;
 
 namespace bydb {
 
-#define TUPLE_GROUP_SIZE 100
+/* Tuple groups are sized in bytes: the first group of a table is small, each
+new one twice the size of the previous, up to a huge page. */
+#define TUPLE_GROUP_MIN_BYTES EXTENT_MIN_SIZE
+#define TUPLE_GROUP_MAX_BYTES HUGE_PAGE_SIZE
 #define TUPLE_HEADER_SIZE 16
+#define TUPLE_ALIGN 8
+#define FROZEN_HEADER_SIZE 8
+/* Groups at most 1 / COMPACT_SPARSE_RATIO full are emptied by compact(). */
+#define COMPACT_SPARSE_RATIO 4
+/* A dictionary pays off while its rows hold few distinct values, a code
+costs far more than the bytes it saves in one row. One with at least
+STRING_DICT_MIN_CODES codes and fewer than STRING_DICT_ROWS_PER_CODE rows per
+code is checked by checkDicts(). */
+#define STRING_DICT_MIN_CODES 256
+#define STRING_DICT_ROWS_PER_CODE 8
 
 typedef unsigned char uchar;
+typedef std::vector<Expr*, ArenaAllocator<Expr*>> ExprList;
 
 struct Tuple {
   Tuple* prev;
@@ -33,6 +55,12 @@ class TupleList {
     head_->prev = nullptr;
     tail_->next = nullptr;
   }
+  ~TupleList() {
+    free(head_);
+    free(tail_);
+  }
+  TupleList(const TupleList&) = delete;
+  TupleList& operator=(const TupleList&) = delete;
 
   void addHead(Tuple* tup) {
     Tuple* ntup = head_->next;
@@ -51,6 +79,14 @@ class TupleList {
     tup->prev = nullptr;
   }
 
+  /* 'ntup' takes the place of 'tup' in the list. */
+  void replace(Tuple* tup, Tuple* ntup) {
+    ntup->prev = tup->prev;
+    ntup->next = tup->next;
+    tup->prev->next = ntup;
+    tup->next->prev = ntup;
+  }
+
   Tuple* popHead() {
     if (head_->next == tail_) {
       return nullptr;
@@ -74,11 +110,124 @@ class TupleList {
 
   bool isEmpty() { return (head_->next == tail_); }
 
+  void swap(TupleList& other) {
+    std::swap(head_, other.head_);
+    std::swap(tail_, other.tail_);
+  }
+
  private:
   Tuple* head_;
   Tuple* tail_;
 };
 
+#define VARSTRING_PREFIX_SIZE 4
+#define VARSTRING_INLINE_SIZE 12
+#define STRING_HEAP_BLOCK_SIZE (64 * 1024)
+
+/* A VARCHAR value as stored in the tuple, in 16 bytes whatever the declared
+length: the length, the first bytes, then either the rest of a short string
+or the offset of a long one in the table's StringHeap. Comparisons look at
+the length and prefix first, and only follow the offset when both match.
+Columns are packed, so the value is copied in and out of the tuple rather
+than accessed in place. */
+struct VarString {
+  uint32_t len;
+  char prefix[VARSTRING_PREFIX_SIZE];
+  union {
+    char rest[VARSTRING_INLINE_SIZE - VARSTRING_PREFIX_SIZE];
+    uint64_t offset;
+  };
+
+  bool isInline() const { return len <= VARSTRING_INLINE_SIZE; }
+};
+
+/* Append only storage of the long VARCHAR values of a table, kept NUL
+terminated so scans can return them without copying. Values overwritten by
+an update stay until the table is dropped, undo images may still point to
+them. */
+class StringHeap {
+ public:
+  StringHeap() : used_(STRING_HEAP_BLOCK_SIZE) {}
+  ~StringHeap();
+
+  uint64_t append(const char* str, size_t len);
+  const char* get(uint64_t offset) {
+    return blocks_[offset >> 32] + (offset & UINT32_MAX);
+  }
+
+ private:
+  std::vector<char*> blocks_;
+  size_t used_;  // bytes used in the last block
+};
+
+/* Dictionary of one string column, rows store the code of their value
+instead of the padded string. Codes are never reused while a transaction is
+open, so undo images keep pointing to the right string. Codes of values no
+row holds anymore are only dropped by TableStore::checkDicts(). */
+class StringDict {
+ public:
+  uint32_t encode(const char* str);
+  /* Returns true if 'str' has no code, no row can hold it then. */
+  bool lookup(const char* str, uint32_t* code);
+  const char* decode(uint32_t code) { return strs_[code]; }
+  size_t size() { return strs_.size(); }
+
+ private:
+  std::unordered_map<std::string, uint32_t> codes_;
+  std::vector<const char*> strs_;  // points to the keys of codes_
+};
+
+/* An extent of tuple slots. */
+struct TupleGroup {
+  Tuple* tuples;
+  size_t bytes;
+  size_t capacity;    // slots
+  size_t live;        // slots handed out and not freed
+  uint64_t modified;  // freeze pass in which a slot was last written
+};
+
+/* A full tuple group nothing was written to for a while, with its INT and
+LONG columns compressed. Its rows only keep a header, the null bitmap and the
+other columns. The header is the group's address with the lowest bit set,
+tuples are aligned so a hot tuple's 'prev' never has it. Frozen rows are
+never changed, they are thawed back into a tuple group first. */
+struct FrozenGroup {
+  uchar* rows;
+  size_t count;
+  std::vector<IntSegment*> segments;  // null for columns kept in the rows
+  FrozenGroup* prev;
+  FrozenGroup* next;
+};
+
+/* Rows a FrozenCursor decodes at a time. */
+#define FROZEN_CURSOR_ROWS 1024
+
+/* The compressed columns of the frozen group a scan is in, each decoded
+FROZEN_CURSOR_ROWS rows at a time from the first row the scan reads.
+Sequential scans pass one to parseTuple() and matchInt(), without one a
+value is read on its own. */
+struct FrozenCursor {
+  struct Column {
+    Column() : first(0) {}
+
+    size_t first;  // row of vals[0]
+    std::vector<int64_t> vals;
+  };
+
+  FrozenCursor() : frozen(nullptr) {}
+
+  FrozenGroup* frozen;
+  std::vector<Column> cols;
+};
+
+/* Consecutive slots of a tuple group, or rows of a frozen group, which a
+parallel scan hands to a worker as one morsel. */
+struct SlotRange {
+  uchar* begin;
+  size_t count;
+  bool frozen;
+};
+
 class TableStore {
  public:
   TableStore(std::vector<ColumnDefinition*>* columns);
@@ -89,26 +238,132 @@ class TableStore {
   bool updateTuple(Tuple* tup, std::vector<size_t>& idxs,
                    std::vector<Expr*>& values);
 
+  uchar* saveColumns(Tuple* tup, std::vector<size_t>& idxs);
+  void restoreColumns(Tuple* tup, uchar* image);
+
   void removeTuple(Tuple* tup);
   void recoverTuple(Tuple* tup);
   void freeTuple(Tuple* tup);
 
   Tuple* seqScan(Tuple* tup);
-  void parseTuple(Tuple* tup, std::vector<Expr*>& values);
+  /* Cuts the tuple groups, then the frozen groups, into ranges of at most
+  'size' slots without reading a tuple. Slots never handed out are left
+  out. */
+  void slotRanges(size_t size, std::vector<SlotRange>* ranges);
+  /* The tuple after 'tup' in 'range', the first one if 'tup' is null. Scans
+  of ranges see the tuples in slot order, not in the order of seqScan(). */
+  Tuple* rangeScan(const SlotRange& range, Tuple* tup);
+  void parseTuple(Tuple* tup, ExprList& values, Arena* arena,
+                  FrozenCursor* cursor = nullptr);
+
+  /* CHAR columns wider than a code are dictionary encoded until
+  checkDicts() finds too many distinct values in them. Partitions decide
+  this each on their own. */
+  StringDict* getDict(size_t idx) { return dicts_[idx]; }
+  bool matchCode(Tuple* tup, size_t idx, uint32_t code);
+  /* For CHAR columns without a dictionary. */
+  bool matchChar(Tuple* tup, size_t idx, const char* str);
+
+  /* Builds the stored form of 'str' without its heap offset, to compare it
+  with matchVarString(). */
+  static void MakeVarString(const char* str, VarString* key);
+  bool matchVarString(Tuple* tup, size_t idx, VarString* key,
+                      const char* str);
+
+  bool matchInt(Tuple* tup, size_t idx, int64_t val,
+                FrozenCursor* cursor = nullptr);
+
+  /* Compresses the full groups nothing was written to since the previous
+  call, returns how many. Tuples move, so this must not run concurrently
+  with a statement or inside a transaction. */
+  size_t freeze();
+  /* Thaws the frozen groups holding a tuple 'match' is true for, or all of
+  them if 'match' is null. Statements call this before they look for the
+  tuples they change. */
+  bool thaw(const std::function<bool(Tuple*)>& match);
+
+  /* Moves the tuples of sparse groups into the free slots of the others and
+  frees the emptied groups, returns how many. Tuples deleted by the open
+  transaction move too, its undo entries are pointed to their new place.
+  Must not run concurrently with a statement. */
+  size_t compact();
+
+  /* Rebuilds the dictionaries that grew too big for the rows with only the
+  values the rows still hold, and stores the columns of those still too big
+  inline from then on, which rewrites every row. Returns how many columns
+  changed. Must not run concurrently with a statement or inside a
+  transaction. */
+  size_t checkDicts();
+
+  static bool IsFrozen(Tuple* tup) {
+    return reinterpret_cast<uintptr_t>(tup->prev) & 1;
+  }
 
   int tupleSize() { return tupleSize_; }
+  size_t tupleCount() { return tupleCount_; }
+  size_t frozenCount() { return frozenCount_; }
+  size_t groupCount() { return tupleGroups_.size(); }
+  /* Bumped by every change of the rows, and by every undo of one. Tuples
+  the compactor moves or freezes keep their values, they do not count. */
+  uint64_t modCount() { return modCount_; }
 
  private:
-  bool newTupleGroup();
+  bool newTupleGroup(size_t min_slots = 1);
+  Tuple* allocTuple();
+  void releaseTuple(Tuple* tup);
+  void pushFree(Tuple* tup) {
+    tup->prev = nullptr;
+    tup->next = freeList_;
+    freeList_ = tup;
+  }
+  TupleGroup* findGroup(Tuple* tup);
+  void touch(Tuple* tup) { findGroup(tup)->modified = passes_; }
   void setColValue(Tuple* tup, int idx, Expr* expr);
 
+  /* Null bitmap and column data of a hot or frozen tuple. */
+  void locate(Tuple* tup, uchar** nulls, uchar** data, const int** offsets);
+  bool isNull(const uchar* nulls, size_t idx) {
+    int bit = nullBit_[idx];
+    return bit >= 0 && (nulls[bit / 8] >> (bit % 8)) & 1;
+  }
+  void setNull(uchar* nulls, size_t idx, bool is_null);
+  Tuple* frozenRow(FrozenGroup* frozen, size_t idx) {
+    return reinterpret_cast<Tuple*>(frozen->rows + idx * frozenSize_);
+  }
+  int64_t frozenValue(FrozenGroup* frozen, size_t row, size_t idx,
+                      FrozenCursor* cursor);
+  bool freezeGroup(TupleGroup* group);
+  bool thawGroup(FrozenGroup* frozen);
+  void layout();
+  bool storeInline(const std::vector<bool>& cols);
+
   int colNum_;
+  int nullBytes_;  // size of the null bitmap
   int tupleSize_;
+  int frozenSize_;
+  size_t tupleCount_;
+  size_t frozenCount_;  // frozen groups
+  uint64_t passes_;     // calls to freeze()
+  uint64_t modCount_;
+  bool hasIntColumn_;
+  bool dictsFull_;  // a dictionary may have grown too big, see checkDicts()
 
   std::vector<ColumnDefinition*>* columns_;
   std::vector<int> colOffset_;
-  std::vector<Tuple*> tupleGroups_;
-  TupleList freeList_;
+  std::vector<int> nullBit_;  // -1 for NOT NULL columns, which have no bit
+  std::vector<int> frozenOffset_;  // offsets in frozen rows
+  std::vector<StringDict*> dicts_;  // null for columns stored as they are
+  StringHeap heap_;
+  std::map<uchar*, TupleGroup*> tupleGroups_;  // by address
+  size_t groupBytes_;  // size of the next group
+  /* Slots of the newest group that were never handed out. They are not put
+  on the free list, so their pages are only touched when they are used. */
+  uchar* unusedBegin_;
+  uchar* unusedEnd_;
+  FrozenGroup* frozenGroups_;
+  /* Free slots, linked through 'next'. Their 'prev' is null, as is that of
+  every slot a scan skips. */
+  Tuple* freeList_;
   TupleList dataList_;
 };
 
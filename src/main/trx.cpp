@@ -1,4 +1,5 @@
 #include "trx.h"
+#include "metadata.h"
 
 namespace bydb {
 Transaction g_transaction;
@@ -7,33 +8,54 @@ void Transaction::addInsertUndo(TableStore* table_store, Tuple* tup) {
   Undo* undo = new Undo(kInsertUndo);
   undo->tableStore = table_store;
   undo->curTup = tup;
-  undoStack_.push(undo);
+  undoStack_.push_back(undo);
 }
 
 void Transaction::addDeleteUndo(TableStore* table_store, Tuple* tup) {
   Undo* undo = new Undo(kDeleteUndo);
   undo->tableStore = table_store;
   undo->oldTup = tup;
-  undoStack_.push(undo);
+  undoStack_.push_back(undo);
 }
 
-void Transaction::addUpdateUndo(TableStore* table_store, Tuple* tup) {
+void Transaction::addUpdateUndo(TableStore* table_store, Tuple* tup,
+                                std::vector<size_t>& idxs) {
   Undo* undo = new Undo(kUpdateUndo);
   undo->tableStore = table_store;
-  undo->oldTup = static_cast<Tuple*>(malloc(table_store->tupleSize()));
-  memcpy(undo->oldTup->data, tup->data,
-         table_store->tupleSize() - TUPLE_HEADER_SIZE);
+  undo->oldCols = table_store->saveColumns(tup, idxs);
   undo->curTup = tup;
-  undoStack_.push(undo);
+  undoStack_.push_back(undo);
+}
+
+void Transaction::addTruncateUndo(Partition* partition,
+                                  TableStore* table_store) {
+  Undo* undo = new Undo(kTruncateUndo);
+  undo->partition = partition;
+  undo->tableStore = table_store;
+  undoStack_.push_back(undo);
+  truncateNum_++;
 }
 
 void Transaction::begin() { inTransaction_ = true; }
 
+void Transaction::relocate(const std::unordered_map<Tuple*, Tuple*>& moved) {
+  for (auto undo : undoStack_) {
+    auto iter = moved.find(undo->curTup);
+    if (iter != moved.end()) {
+      undo->curTup = iter->second;
+    }
+    iter = moved.find(undo->oldTup);
+    if (iter != moved.end()) {
+      undo->oldTup = iter->second;
+    }
+  }
+}
+
 void Transaction::rollback() {
   while (!undoStack_.empty()) {
-    auto undo = undoStack_.top();
+    auto undo = undoStack_.back();
     TableStore* table_store = undo->tableStore;
-    undoStack_.pop();
+    undoStack_.pop_back();
     switch (undo->type) {
       case kInsertUndo:
         table_store->removeTuple(undo->curTup);
@@ -42,27 +64,38 @@ void Transaction::rollback() {
         table_store->recoverTuple(undo->oldTup);
         break;
       case kUpdateUndo:
-        memcpy(undo->curTup->data, undo->oldTup->data,
-               table_store->tupleSize() - TUPLE_HEADER_SIZE);
+        table_store->restoreColumns(undo->curTup, undo->oldCols);
+        break;
+      case kTruncateUndo:
+        undo->partition->restoreStore(table_store);
         break;
       default:
         break;
     }
     delete undo;
   }
+  truncateNum_ = 0;
   inTransaction_ = false;
 }
 
+/* Truncated stores go last, older entries may still free tuples in them. */
 void Transaction::commit() {
-  while (undoStack_.empty()) {
-    auto undo = undoStack_.top();
+  std::vector<TableStore*> truncated;
+  while (!undoStack_.empty()) {
+    auto undo = undoStack_.back();
     TableStore* table_store = undo->tableStore;
-    undoStack_.pop();
+    undoStack_.pop_back();
     if (undo->type == kDeleteUndo) {
       table_store->freeTuple(undo->oldTup);
+    } else if (undo->type == kTruncateUndo) {
+      truncated.push_back(table_store);
     }
     delete undo;
   }
+  for (auto table_store : truncated) {
+    delete table_store;
+  }
+  truncateNum_ = 0;
   inTransaction_ = false;
 }
 
@@ -2,44 +2,63 @@
 
 #include "storage.h"
 
-#include <stack>
+#include <unordered_map>
+#include <vector>
 
 namespace bydb {
-enum UndoType { kInsertUndo, kDeleteUndo, kUpdateUndo };
+class Partition;
+
+enum UndoType { kInsertUndo, kDeleteUndo, kUpdateUndo, kTruncateUndo };
 
 struct Undo {
   Undo(UndoType t)
-      : type(t), tableStore(nullptr), curTup(nullptr), oldTup(nullptr) {}
+      : type(t),
+        partition(nullptr),
+        tableStore(nullptr),
+        curTup(nullptr),
+        oldTup(nullptr),
+        oldCols(nullptr) {}
   ~Undo() {
     if (type == kUpdateUndo) {
-      free(oldTup);
+      free(oldCols);
     }
   }
 
   UndoType type;
-  TableStore* tableStore;
+  Partition* partition;     // truncate only
+  TableStore* tableStore;   // truncate: the store the partition had before
   Tuple* curTup;
   Tuple* oldTup;
+  uchar* oldCols;  // before-image of the updated columns only
 };
 
 class Transaction {
  public:
-  Transaction() : inTransaction_(false) {}
+  Transaction() : inTransaction_(false), truncateNum_(0) {}
   ~Transaction() {}
 
   void addInsertUndo(TableStore* table_store, Tuple* tup);
   void addDeleteUndo(TableStore* table_store, Tuple* tup);
-  void addUpdateUndo(TableStore* table_store, Tuple* tup);
+  void addUpdateUndo(TableStore* table_store, Tuple* tup,
+                     std::vector<size_t>& idxs);
+  void addTruncateUndo(Partition* partition, TableStore* table_store);
 
   void begin();
   void rollback();
   void commit();
 
+  /* Points the undo entries to where the compactor moved their tuples. */
+  void relocate(const std::unordered_map<Tuple*, Tuple*>& moved);
+
   bool inTransaction() { return inTransaction_; }
+  /* Whether the transaction truncated a partition, whose undo still points
+  to it until commit or rollback. */
+  bool hasTruncated() { return truncateNum_ > 0; }
 
  private:
   bool inTransaction_;
-  std::stack<Undo*> undoStack_;
+  size_t truncateNum_;
+  std::vector<Undo*> undoStack_;
 };
 
 extern Transaction g_transaction;
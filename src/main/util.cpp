@@ -161,11 +161,57 @@ const char* PlanTypeToString(PlanType type) {
       return "Trx";
     case kShow:
       return "Show";
+    case kPrepare:
+      return "Prepare";
+    case kExecute:
+      return "Execute";
+    case kAnalyze:
+      return "Analyze";
+    case kExplain:
+      return "Explain";
+    case kTruncate:
+      return "Truncate";
+    case kPartition:
+      return "Partition";
+    case kSetOp:
+      return "SetOp";
+    case kDistinct:
+      return "Distinct";
+    case kSemiJoin:
+      return "SemiJoin";
     default:
       return "UNKNOWN";
   }
 }
 
+const char* SetTypeToString(SetType type) {
+  switch (type) {
+    case kSetUnion:
+      return "Union";
+    case kSetIntersect:
+      return "Intersect";
+    case kSetExcept:
+      return "Except";
+    default:
+      return "UNKNOWN";
+  }
+}
+
+std::string LiteralToString(Expr* expr) {
+  switch (expr->type) {
+    case kExprLiteralInt:
+      return std::to_string(expr->ival);
+    case kExprLiteralString:
+      return std::string("'") + expr->name + "'";
+    case kExprLiteralNull:
+      return "NULL";
+    case kExprParameter:
+      return "?";
+    default:
+      return ExprTypeToString(expr->type);
+  }
+}
+
 size_t ColumnTypeSize(ColumnType& type) {
   switch (type.data_type) {
     case DataType::INT:
@@ -175,12 +221,60 @@ size_t ColumnTypeSize(ColumnType& type) {
     case DataType::CHAR:
       return type.length + 1;
     case DataType::VARCHAR:
-      return type.length + 1;
+      return sizeof(VarString);
     default:
       return -1;
   }
 }
 
+bool CheckColumnValue(ColumnDefinition* col_def, Expr* expr) {
+  if (expr->type == kExprLiteralNull) {
+    if (!col_def->nullable) {
+      std::cout << "[BYDB-Error]  Column " << col_def->name
+                << " can not be NULL" << std::endl;
+      return true;
+    }
+    return false;
+  }
+
+  switch (col_def->type.data_type) {
+    case DataType::INT:
+    case DataType::LONG:
+      if (expr->type != kExprLiteralInt) {
+        std::cout << "[BYDB-Error]  Invalid insert value type "
+                  << ExprTypeToString(expr->type) << " for column "
+                  << col_def->name << std::endl;
+        return true;
+      }
+      if (col_def->type.data_type == DataType::INT && expr->ival > INT32_MAX) {
+        std::cout << "[BYDB-Error]  The value " << expr->ival
+                  << " exceed the limitation of INT32_MAX" << std::endl;
+        return true;
+      }
+      break;
+    case DataType::CHAR:
+    case DataType::VARCHAR:
+      if (expr->type != kExprLiteralString) {
+        std::cout << "[BYDB-Error]  Invalid insert value type "
+                  << ExprTypeToString(expr->type) << " for column "
+                  << col_def->name << std::endl;
+        return true;
+      }
+      if (strlen(expr->name) > static_cast<size_t>(col_def->type.length)) {
+        std::cout << "[BYDB-Error]  The value '" << expr->name
+                  << "' is too long for column " << col_def->name
+                  << std::endl;
+        return true;
+      }
+      break;
+    default:
+      return true;
+      break;
+  }
+
+  return false;
+}
+
 /* 
 INT32_MAX: 2,147,483,647
 INT64_MAX: 9,223,372,036,854,775,807
@@ -190,8 +284,7 @@ add one more byte for the symbol
 #define MAX_INT64_LEN 20
 
 void PrintTuples(std::vector<ColumnDefinition*>& columns,
-                 std::vector<size_t>& colIds,
-                 std::vector<std::vector<Expr*>>& tuples) {
+                 std::vector<size_t>& colIds, TupleIterList& tuples) {
   if (tuples.size() == 0) {
     std::cout << "Empty set" << std::endl;
     return;
@@ -226,7 +319,7 @@ void PrintTuples(std::vector<ColumnDefinition*>& columns,
   /* Print each tuple */
   for (auto tup : tuples) {
     for (size_t i = 0; i < columns.size(); i++) {
-      Expr* expr = tup[colIds[i]];
+      Expr* expr = tup->values[colIds[i]];
       std::cout.width(col_lens[i]);
       switch (expr->type) {
         case kExprLiteralString:
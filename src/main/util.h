@@ -1,5 +1,6 @@
 #pragma once
 
+#include "executor.h"
 #include "optimizer.h"
 #include "storage.h"
 
@@ -7,7 +8,12 @@
 #include "sql/Table.h"
 #include "sql/statements.h"
 
+#include <chrono>
+#include <cstdint>
 #include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 using namespace hsql;
 
@@ -28,16 +34,31 @@ inline void SetTableName(TableName& table_name, char* schema, char* name) {
   table_name.name = name;
 }
 
+/* Time stamp counter where there is one, nanoseconds elsewhere. */
+inline uint64_t ReadCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
 const char* StmtTypeToString(StatementType type);
 const char* DataTypeToString(DataType type);
 const char* DropTypeToString(DropType type);
 const char* ExprTypeToString(ExprType type);
 const char* PlanTypeToString(PlanType type);
+const char* SetTypeToString(SetType type);
+
+std::string LiteralToString(Expr* expr);
 
 size_t ColumnTypeSize(ColumnType& type);
 
+bool CheckColumnValue(ColumnDefinition* col_def, Expr* expr);
+
 void PrintTuples(std::vector<ColumnDefinition*>& columns,
-                 std::vector<size_t>& colIds,
-                 std::vector<std::vector<Expr*>>& tuples);
+                 std::vector<size_t>& colIds, TupleIterList& tuples);
 
 }  // namespace bydb
\ No newline at end of file